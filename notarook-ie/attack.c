@@ -9,6 +9,10 @@
 /**
  * Takes in the square in question, the attacking side, and the board
  * figures out if the given square is being attacke
+ *
+ * Works backwards from the square: a knight on our square would attack every square
+ * an enemy knight could be attacking us from, and the same goes for every other piece
+ * (except pawns, where we have to look from the other color's point of view)
  */
 bool square_attacked(const int32_t square, const int32_t side, const Board_t *board) {
 
@@ -16,65 +20,123 @@ bool square_attacked(const int32_t square, const int32_t side, const Board_t *bo
   ASSERT(side_valid(side));
   ASSERT(check_board(board));
 
-  int32_t piece, ind, temp_square, dir;
+  int32_t sq64 = SQ64(square);
+  uint64_t occupied = board->color_bbs[BOTH];
+
+  // the attacking side's pieces start at wP for white and bP for black
+  // (see the PIECES enum)
+  int32_t offset = (side == WHITE) ? 0 : (bP - wP);
 
   // pawns
-  // the subtraction is for going back diagonally, addition for up diagonally
-  if(side == WHITE) {
-    if(board->pieces[square - 11] == wP || board->pieces[square - 9] == wP) return true;
-  } else {
-    if(board->pieces[square + 11] == bP || board->pieces[square + 9] == bP) return true;
-  }
+  if(PAWN_ATTACKS[side ^ 1][sq64] & board->piece_bbs[wP + offset]) return true;
 
   // knights
-  for(ind = 0; ind < (int32_t)(sizeof(KNIGHT_DIRS) / sizeof(*KNIGHT_DIRS)); ++ind) {
-    piece = board->pieces[square + KNIGHT_DIRS[ind]];
-    if(piece != EMPTY && piece != OFFBOARD && IsKn(piece) && PIECE_COL[piece] == side)
-      return true;
-  }
+  if(KNIGHT_ATTACKS[sq64] & board->piece_bbs[wN + offset]) return true;
 
   // rooks and queens
-  for(ind = 0; ind < (int32_t)(sizeof(ROOK_DIRS) / sizeof(*ROOK_DIRS)); ++ind) {
-    dir = ROOK_DIRS[ind];
-    temp_square = square + dir;
-    piece = board->pieces[temp_square];
-
-    while(piece != OFFBOARD) {
-      if(piece != EMPTY) {
-        if(IsRQ(piece) && PIECE_COL[piece] == side) {
-          return true;
-        }
-        break;
-      }
-      temp_square += dir;
-      piece = board->pieces[temp_square];
-    }
-  }
+  if(ROOK_ATTACKS(sq64, occupied) & (board->piece_bbs[wR + offset] | board->piece_bbs[wQ + offset])) return true;
 
   // bishops and queens
-  for(ind = 0; ind < (int32_t)(sizeof(BISHOP_DIRS) / sizeof(*BISHOP_DIRS)); ++ind) {
-    dir = BISHOP_DIRS[ind];
-    temp_square = square + dir;
-    piece = board->pieces[temp_square];
-
-    while(piece != OFFBOARD) {
-      if(piece != EMPTY) {
-        if(IsBQ(piece) && PIECE_COL[piece] == side) {
-          return true;
-        }
+  if(BISHOP_ATTACKS(sq64, occupied) & (board->piece_bbs[wB + offset] | board->piece_bbs[wQ + offset])) return true;
+
+  // kings
+  if(KING_ATTACKS[sq64] & board->piece_bbs[wK + offset]) return true;
+
+  return false;
+}
+
+/**
+ * Finds every piece (of both colors) attacking a 64 square index, given which squares
+ * are occupied. The occupancy gets passed in separately so that the exchange
+ * evaluation below can take pieces off and see what was behind them (and so the
+ * legal move generator can see what a square looks like once the king steps off)
+ */
+uint64_t attackers_to(const Board_t *board, const int32_t sq64, const uint64_t occupied) {
+  uint64_t rooks = board->piece_bbs[wR] | board->piece_bbs[bR] | board->piece_bbs[wQ] | board->piece_bbs[bQ];
+  uint64_t bishops = board->piece_bbs[wB] | board->piece_bbs[bB] | board->piece_bbs[wQ] | board->piece_bbs[bQ];
+
+  return (PAWN_ATTACKS[BLACK][sq64] & board->piece_bbs[wP])
+       | (PAWN_ATTACKS[WHITE][sq64] & board->piece_bbs[bP])
+       | (KNIGHT_ATTACKS[sq64] & (board->piece_bbs[wN] | board->piece_bbs[bN]))
+       | (KING_ATTACKS[sq64] & (board->piece_bbs[wK] | board->piece_bbs[bK]))
+       | (ROOK_ATTACKS(sq64, occupied) & rooks)
+       | (BISHOP_ATTACKS(sq64, occupied) & bishops);
+}
+
+/**
+ * Static exchange evaluation: plays out every capture and recapture on the target
+ * square of a capture, always with the least valuable piece, and returns how much
+ * material the side making the capture comes out ahead (or behind) by.
+ * Either side can stop capturing whenever carrying on would only lose more, which
+ * is what the backwards pass over the gains at the end works out.
+ * See https://www.chessprogramming.org/SEE_-_The_Swap_Algorithm
+ * Promotions aren't counted, so those come out a bit pessimistic
+ */
+int32_t static_exchange(const Board_t *board, const uint32_t move) {
+
+  ASSERT(check_board(board));
+
+  int32_t from = SQ64(FROMSQ(move)), to = SQ64(TOSQ(move));
+  int32_t gain[32];
+  int32_t depth = 0;
+  int32_t side = board->side;
+
+  // the piece that moves onto the square next (and could get captured there)
+  int32_t attacker = board->pieces[FROMSQ(move)];
+  uint64_t occupied = board->color_bbs[BOTH] ^ SET_MASK[from];
+
+  if(move & MFLAGEP) {
+    // the captured pawn isn't on the target square
+    gain[0] = PIECE_VAL[wP];
+    occupied ^= SET_MASK[(side == WHITE) ? to - 8 : to + 8];
+  } else {
+    gain[0] = PIECE_VAL[CAPTURED(move)];
+  }
+
+  uint64_t attackers = attackers_to(board, to, occupied) & occupied;
+
+  while(true) {
+    side ^= 1;
+
+    // find the least valuable piece the side to move can recapture with
+    int32_t offset = (side == WHITE) ? 0 : (bP - wP);
+    int32_t piece = EMPTY;
+    uint64_t candidates = 0;
+
+    for(int32_t type = wP; type <= wK; ++type) {
+      candidates = attackers & board->piece_bbs[type + offset];
+      if(candidates) {
+        piece = type + offset;
         break;
       }
-      temp_square += dir;
-      piece = board->pieces[temp_square];
     }
+
+    if(piece == EMPTY) break;
+
+    // a king can't recapture onto a square that's still attacked
+    if((piece == wK || piece == bK) && (attackers & board->color_bbs[side ^ 1])) break;
+
+    // this side takes whatever is sitting on the square
+    ++depth;
+    gain[depth] = PIECE_VAL[attacker] - gain[depth - 1];
+
+    // no matter how the rest goes, neither side can do better by carrying on
+    if(-gain[depth - 1] < 0 && gain[depth] < 0) break;
+
+    // take the recapturing piece off of the board, which might uncover a slider behind it
+    occupied ^= candidates & -candidates;
+    attackers |= attackers_to(board, to, occupied);
+    attackers &= occupied;
+    attacker = piece;
+
+    if(depth == 31) break;
   }
 
-  // kings
-  for(ind = 0; ind < (int32_t)(sizeof(KING_DIRS) / sizeof(*KING_DIRS)); ++ind) {
-    piece = board->pieces[square + KING_DIRS[ind]];
-    if(piece != OFFBOARD && piece != EMPTY && IsKi(piece) && PIECE_COL[piece] == side)
-      return true;
+  // work backwards: each side picks the better of stopping or recapturing
+  while(depth > 0) {
+    gain[depth - 1] = -((-gain[depth - 1] > gain[depth]) ? -gain[depth - 1] : gain[depth]);
+    --depth;
   }
 
-  return false;
+  return gain[0];
 }
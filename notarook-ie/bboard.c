@@ -10,6 +10,32 @@
  */
 
 #include "constants.h"
+#include "functions.h"
+
+// these are initially declared in constants.h
+uint64_t KNIGHT_ATTACKS[STANDARD_BOARD_SIZE];
+uint64_t KING_ATTACKS[STANDARD_BOARD_SIZE];
+uint64_t PAWN_ATTACKS[2][STANDARD_BOARD_SIZE];
+
+Magic_t ROOK_MAGICS[STANDARD_BOARD_SIZE];
+Magic_t BISHOP_MAGICS[STANDARD_BOARD_SIZE];
+
+uint64_t BETWEEN_BB[STANDARD_BOARD_SIZE][STANDARD_BOARD_SIZE];
+uint64_t LINE_BB[STANDARD_BOARD_SIZE][STANDARD_BOARD_SIZE];
+
+// every attack set for every square and every blocker setup that matters.
+// the sizes are 2^(number of squares in the mask) summed over all 64 squares
+static uint64_t ROOK_ATTACK_TABLE[0x19000];
+static uint64_t BISHOP_ATTACK_TABLE[0x1480];
+
+// directions pieces move in, as (file, rank) steps
+// working in files and ranks makes it easy to tell when we've walked off the board
+static const int32_t ROOK_STEPS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+static const int32_t BISHOP_STEPS[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+static const int32_t KNIGHT_STEPS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+static const int32_t KING_STEPS[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+#ifndef __GNUC__
 
 // why this order? look it up
 // I just kind of said "...okay" and used it
@@ -20,6 +46,8 @@ static const int32_t BIT_TABLE[64] = {
   58, 20, 37, 17, 36, 8
 };
 
+#endif
+
 /**
  * Function that returns the index of the LSB in the bitboard that is set
  * to 1, while setting said index to 0
@@ -27,6 +55,16 @@ static const int32_t BIT_TABLE[64] = {
  * properly explain; hopefully the code is straightfoward enough?
  */
 int32_t pop_bit(uint64_t *board_ptr) {
+
+#ifdef __GNUC__
+
+  // gcc and clang can just do this in one instruction
+  int32_t index = __builtin_ctzll(*board_ptr);
+  *board_ptr &= (*board_ptr - 1);
+  return index;
+
+#else
+
   uint64_t bit = *board_ptr ^ (*board_ptr - 1);
 
   uint32_t fold = (uint32_t)((bit & 0xFFFFFFFF) ^ (bit >> 32));
@@ -34,6 +72,8 @@ int32_t pop_bit(uint64_t *board_ptr) {
   *board_ptr &= (*board_ptr - 1);
 
   return BIT_TABLE[(fold * MAGIC_BIT_NUM) >> 26];
+
+#endif
 }
 
 /**
@@ -41,6 +81,13 @@ int32_t pop_bit(uint64_t *board_ptr) {
  * (but you probably already could tell that, from the name)
  */
 int32_t count_bits(uint64_t board) {
+
+#ifdef __GNUC__
+
+  return __builtin_popcountll(board);
+
+#else
+
   int32_t result;
 
   // weird looking, but this pretty much decrements one from the board
@@ -48,4 +95,157 @@ int32_t count_bits(uint64_t board) {
   for(result = 0; board; result++, board &= board - 1);
 
   return result;
+
+#endif
+}
+
+/**
+ * Returns the bitboard with just the given (file, rank) square set,
+ * or an empty bitboard if the square is off the board
+ */
+static uint64_t square_bit(const int32_t file, const int32_t rank) {
+  if(!file_rank_valid(file) || !file_rank_valid(rank)) return (uint64_t)0;
+  return (uint64_t)1 << (rank * 8 + file);
+}
+
+/**
+ * Builds the attacks of a piece that moves one step at a time (knights, kings)
+ */
+static uint64_t step_attacks(const int32_t sq64, const int32_t steps[][2], const int32_t num_steps) {
+  uint64_t attacks = 0;
+
+  for(int32_t dir = 0; dir < num_steps; ++dir) {
+    attacks |= square_bit(sq64 % 8 + steps[dir][0], sq64 / 8 + steps[dir][1]);
+  }
+  return attacks;
+}
+
+/**
+ * Builds the attacks of a sliding piece the slow way, by walking each ray
+ * until it hits a blocker (which is included, since it could be a capture).
+ * Only used to fill in the lookup tables.
+ */
+static uint64_t slider_attacks(const int32_t sq64, const uint64_t occupied, const int32_t steps[4][2]) {
+  uint64_t attacks = 0, bit;
+
+  for(int32_t dir = 0; dir < 4; ++dir) {
+    int32_t file = sq64 % 8 + steps[dir][0];
+    int32_t rank = sq64 / 8 + steps[dir][1];
+
+    while((bit = square_bit(file, rank))) {
+      attacks |= bit;
+      if(occupied & bit) break;
+
+      file += steps[dir][0];
+      rank += steps[dir][1];
+    }
+  }
+  return attacks;
+}
+
+/**
+ * Builds the mask of squares that could block a sliding piece.
+ * The last square of every ray is left out: whatever is sitting on the
+ * edge of the board, the piece attacks it either way
+ */
+static uint64_t slider_mask(const int32_t sq64, const int32_t steps[4][2]) {
+  uint64_t mask = 0;
+
+  for(int32_t dir = 0; dir < 4; ++dir) {
+    int32_t file = sq64 % 8 + steps[dir][0];
+    int32_t rank = sq64 / 8 + steps[dir][1];
+
+    while(square_bit(file + steps[dir][0], rank + steps[dir][1])) {
+      mask |= square_bit(file, rank);
+      file += steps[dir][0];
+      rank += steps[dir][1];
+    }
+  }
+  return mask;
+}
+
+/**
+ * Fills in the attack table for every square using the given magic numbers.
+ * A magic number is one where (blockers * magic) >> shift gives a different index for every
+ * blocker setup that leads to different attacks, so one multiply and one shift
+ * replaces walking every ray. The numbers themselves live in consts.c.
+ * See https://www.chessprogramming.org/Looking_for_Magics
+ *
+ * The BMI2 build (USE_PEXT) ignores the magic numbers and uses pext to get the index
+ * instead. That gives indexes in the same range, so the table layout doesn't change.
+ */
+static void init_magics(Magic_t *magics, uint64_t *table, const uint64_t *magic_nums, const int32_t steps[4][2]) {
+  for(int32_t sq64 = 0; sq64 < STANDARD_BOARD_SIZE; ++sq64) {
+    Magic_t *magic = &magics[sq64];
+
+    magic->mask = slider_mask(sq64, steps);
+    magic->magic = magic_nums[sq64];
+    magic->shift = 64 - count_bits(magic->mask);
+    magic->attacks = table;
+
+    // run through every subset of the mask (the carry-rippler trick) and
+    // store the real attacks for each of them
+    uint64_t subset = 0;
+    int32_t size = 0;
+    do {
+      uint64_t attacks = slider_attacks(sq64, subset, steps);
+      uint64_t index = MAGIC_INDEX(magic, subset);
+
+      // two setups can share an index only if they have the same attacks
+      ASSERT(!magic->attacks[index] || magic->attacks[index] == attacks);
+      magic->attacks[index] = attacks;
+
+      ++size;
+      subset = (subset - magic->mask) & magic->mask;
+    } while(subset);
+
+    // next square's attacks go right after this one's
+    table += size;
+  }
+}
+
+/**
+ * Fills in all of the attack lookup tables
+ */
+void init_bitboards(void) {
+
+#ifdef USE_PEXT
+  // better to bail out now than to crash on an illegal instruction mid game
+  if(!__builtin_cpu_supports("bmi2")) {
+    fprintf(stderr, "This build needs a CPU with BMI2 (pext). Use the regular build (`make`) instead.\n");
+    exit(1);
+  }
+#endif
+
+  for(int32_t sq64 = 0; sq64 < STANDARD_BOARD_SIZE; ++sq64) {
+    int32_t file = sq64 % 8, rank = sq64 / 8;
+
+    KNIGHT_ATTACKS[sq64] = step_attacks(sq64, KNIGHT_STEPS, 8);
+    KING_ATTACKS[sq64] = step_attacks(sq64, KING_STEPS, 8);
+
+    // white pawns attack up the board, black pawns attack down
+    PAWN_ATTACKS[WHITE][sq64] = square_bit(file - 1, rank + 1) | square_bit(file + 1, rank + 1);
+    PAWN_ATTACKS[BLACK][sq64] = square_bit(file - 1, rank - 1) | square_bit(file + 1, rank - 1);
+  }
+
+  init_magics(ROOK_MAGICS, ROOK_ATTACK_TABLE, ROOK_MAGIC_NUMS, ROOK_STEPS);
+  init_magics(BISHOP_MAGICS, BISHOP_ATTACK_TABLE, BISHOP_MAGIC_NUMS, BISHOP_STEPS);
+
+  // the squares between and the whole line through every pair of squares that
+  // share a rank, file, or diagonal. Both stay empty for squares that don't.
+  // a slider on one of them sees the other one through an empty board, and the
+  // squares in between are the ones both of them see with just the other in the way
+  for(int32_t from = 0; from < STANDARD_BOARD_SIZE; ++from) {
+    for(int32_t to = 0; to < STANDARD_BOARD_SIZE; ++to) {
+      if(from == to) continue;
+
+      if(ROOK_ATTACKS(from, 0) & SET_MASK[to]) {
+        BETWEEN_BB[from][to] = ROOK_ATTACKS(from, SET_MASK[to]) & ROOK_ATTACKS(to, SET_MASK[from]);
+        LINE_BB[from][to] = (ROOK_ATTACKS(from, 0) & ROOK_ATTACKS(to, 0)) | SET_MASK[from] | SET_MASK[to];
+      } else if(BISHOP_ATTACKS(from, 0) & SET_MASK[to]) {
+        BETWEEN_BB[from][to] = BISHOP_ATTACKS(from, SET_MASK[to]) & BISHOP_ATTACKS(to, SET_MASK[from]);
+        LINE_BB[from][to] = (BISHOP_ATTACKS(from, 0) & BISHOP_ATTACKS(to, 0)) | SET_MASK[from] | SET_MASK[to];
+      }
+    }
+  }
 }
@@ -0,0 +1,171 @@
+/**
+ * This file has the benchmark (`notarookie bench [depth] [threads] [hash MB]`).
+ * It searches a fixed set of positions to a fixed depth and adds up the nodes.
+ * On one thread the search always visits the same nodes, so the total only changes
+ * when the search itself changes. That makes it a signature for catching changes that
+ * were supposed to be speed only, and the nodes/sec gives the speed to compare builds with.
+ *
+ * There's also a micro benchmark for parse_move (`notarookie parsebench [iterations]`)
+ * down at the bottom, which uses the same positions.
+ */
+
+#include "constants.h"
+#include "functions.h"
+
+// a mix of openings, middlegames, and endgames. Mostly taken from the Stockfish
+// bench, plus some of the usual perft positions since they're full of tactics
+static const char *BENCH_FENS[] = {
+  START_FEN,
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQkq a6 0 14",
+  "4rrk1/2p1b1p1/p1p3q1/4p3/2P2n1p/1P1NR2P/PB3PP1/3R1QK1 b - - 2 24",
+  "r3qbrk/6p1/2b2pPp/p3pP1Q/PpPpP2P/3P1B2/2PB3K/R5R1 w - - 16 42",
+  "6k1/1R3p2/6p1/2Bp3p/3P2q1/P7/1P2rQ1K/5R2 b - - 4 44",
+  "8/8/1p2k1p1/3p3p/1p1P1P1P/1P2PK2/8/8 w - - 3 54",
+  "7r/2p3k1/1p1p1qp1/1P1Bp3/p1P2r1P/P7/4R3/Q4RK1 w - - 0 36",
+  "r1bq1rk1/pp2b1pp/n1pp1n2/3P1p2/2P1p3/2N1P2N/PP2BPPP/R1BQ1RK1 b - - 2 10",
+  "3r3k/2r4p/1p1b3q/p4P2/P2Pp3/1B2P3/3BQ1RP/6K1 w - - 3 87",
+  "2r4r/1p4k1/1Pnp4/3Qb1pq/8/4BpPp/5P2/2RR1BK1 w - - 0 42",
+  "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+  "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+  "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1"
+};
+
+/**
+ * Runs the benchmark. Every position starts from an empty hashset so that
+ * the result doesn't depend on what got searched before it
+ */
+void bench(Board_t *board, SearchInfo_t *info, int32_t depth, int32_t threads, int32_t megabytes) {
+  int32_t count = sizeof(BENCH_FENS) / sizeof(BENCH_FENS[0]);
+  Polybook_t no_book = {0};
+  uint64_t nodes = 0;
+  unsigned long elapsed = 0;
+
+  if(!init_hashset(&board->hash_table, megabytes)) exit(1);
+
+  info->game_mode = BENCHMODE;
+  info->post_thinking = false;
+  info->threads = threads;
+  info->timeset = false;
+
+  printf("Benchmarking %s: %d positions, depth %d, %d thread(s), %dMB hash\n\n", NAME, count, depth, threads, megabytes);
+
+  for(int32_t idx = 0; idx < count; ++idx) {
+    parse_FEN(BENCH_FENS[idx], board);
+    clear_hashset(&board->hash_table);
+
+    info->depth = depth;
+    info->starttime = get_time_millis();
+    search_position(board, info, false, no_book);
+    unsigned long time = get_time_millis() - info->starttime;
+
+    printf("Position %2d/%d: %10ld nodes %6lu ms\n", idx + 1, count, info->nodes, time);
+    fflush(stdout);
+    nodes += info->nodes;
+    elapsed += time;
+  }
+
+  printf("\nTotal nodes: %llu Time: %lu ms Nodes/sec: %llu\n", (unsigned long long)nodes, elapsed,
+    (unsigned long long)(nodes * 1000 / (elapsed ? elapsed : 1)));
+}
+
+/**
+ * The way parse_move used to find a move: generate every move in the position
+ * and look for the one with matching squares (and promotion). Only kept around
+ * to compare parse_move against
+ */
+static uint32_t parse_move_by_generation(const char *str, const Board_t *board) {
+  if(str[1] > '8' || str[1] < '1') return NOMOVE;
+  if(str[3] > '8' || str[3] < '1') return NOMOVE;
+  if(str[0] > 'h' || str[0] < 'a') return NOMOVE;
+  if(str[2] > 'h' || str[2] < 'a') return NOMOVE;
+
+  int32_t from = CONVERT_COORDS(str[0] - 'a', str[1] - '1');
+  int32_t to = CONVERT_COORDS(str[2] - 'a', str[3] - '1');
+
+  MoveList_t list;
+  generate_all_moves(board, &list);
+
+  for(int32_t ind = 0; ind < list.count; ++ind) {
+    uint32_t move = list.moves[ind].move;
+    if((int32_t)FROMSQ(move) != from || (int32_t)TOSQ(move) != to) continue;
+
+    int32_t promotion_piece = PROMOTED(move);
+    if(promotion_piece == EMPTY) return move;
+    if(IsRQ(promotion_piece) && !IsBQ(promotion_piece) && str[4] == 'r') return move;
+    if(!IsRQ(promotion_piece) && IsBQ(promotion_piece) && str[4] == 'b') return move;
+    if(IsRQ(promotion_piece) && IsBQ(promotion_piece) && str[4] == 'q') return move;
+    if(IsKn(promotion_piece) && str[4] == 'n') return move;
+  }
+  return NOMOVE;
+}
+
+/**
+ * Micro benchmark for parse_move (`notarookie parsebench [iterations]`).
+ * Parses every legal move in each of the bench positions, plus each of them
+ * backwards (which almost never is a move) to cover the misses too, first
+ * the old way and then with parse_move. Both have to agree on every one
+ */
+void bench_parse_move(Board_t *board, int32_t iterations) {
+  int32_t count = sizeof(BENCH_FENS) / sizeof(BENCH_FENS[0]);
+  unsigned long generated_time = 0, direct_time = 0;
+  uint64_t parsed = 0, sink = 0;
+
+  printf("Benchmarking parse_move: %d positions, %d iterations\n\n", count, iterations);
+
+  for(int32_t idx = 0; idx < count; ++idx) {
+    parse_FEN(BENCH_FENS[idx], board);
+
+    // every legal move, forwards and backwards
+    char strs[2 * MAX_POSITION_MOVES][6];
+    int32_t num_strs = 0;
+    MoveList_t list;
+    generate_all_moves(board, &list);
+    for(int32_t mv = 0; mv < list.count; ++mv) {
+      uint32_t move = list.moves[mv].move;
+      if(!make_move(board, move)) continue;
+      take_move(board);
+
+      // the backwards one swaps the squares and keeps the rest (promotion piece and all)
+      char forward[6];
+      strcpy(forward, print_move(move));
+      strcpy(strs[num_strs++], forward);
+      strcpy(strs[num_strs], forward);
+      strs[num_strs][0] = forward[2];
+      strs[num_strs][1] = forward[3];
+      strs[num_strs][2] = forward[0];
+      strs[num_strs][3] = forward[1];
+      ++num_strs;
+    }
+
+    for(int32_t str = 0; str < num_strs; ++str) {
+      if(parse_move(strs[str], board) != parse_move_by_generation(strs[str], board)) {
+        printf("parse_move disagrees on %s in position %d (%s)\n", strs[str], idx + 1, BENCH_FENS[idx]);
+        exit(1);
+      }
+    }
+
+    unsigned long start = get_time_millis();
+    for(int32_t iter = 0; iter < iterations; ++iter) {
+      for(int32_t str = 0; str < num_strs; ++str) sink += parse_move_by_generation(strs[str], board);
+    }
+    generated_time += get_time_millis() - start;
+
+    start = get_time_millis();
+    for(int32_t iter = 0; iter < iterations; ++iter) {
+      for(int32_t str = 0; str < num_strs; ++str) sink += parse_move(strs[str], board);
+    }
+    direct_time += get_time_millis() - start;
+
+    parsed += (uint64_t)num_strs * iterations;
+  }
+
+  // (the sum of the moves is printed so the compiler can't skip the parsing)
+  printf("Generate and search: %lu ms (%.1f ns/move)\n", generated_time, generated_time * 1e6 / parsed);
+  printf("Direct decoding:     %lu ms (%.1f ns/move)\n", direct_time, direct_time * 1e6 / parsed);
+  printf("\nParsed %llu moves, checksum %llu\n", (unsigned long long)parsed, (unsigned long long)sink);
+}
@@ -16,6 +16,8 @@ bool check_board(const Board_t * board) {
   int32_t temp_maj_piece[2] = {0,0};
   int32_t temp_min_piece[2] = {0,0};
   int32_t temp_material[2] = {0,0};
+  int32_t temp_psqt_mg[2] = {0,0};
+  int32_t temp_psqt_eg[2] = {0,0};
 
   int32_t sq64, temp_piece, temp_pnum, sq120, color, piece_count;
 
@@ -45,6 +47,11 @@ bool check_board(const Board_t * board) {
     if(PIECE_MAJ[temp_piece]) temp_maj_piece[color]++;
 
     temp_material[color] += PIECE_VAL[temp_piece];
+
+    if(temp_piece != EMPTY) {
+      temp_psqt_mg[color] += PSQT_MG[temp_piece][sq64];
+      temp_psqt_eg[color] += PSQT_EG[temp_piece][sq64];
+    }
   }
 
   for(temp_piece = wP; temp_piece <= bK; ++temp_piece)
@@ -76,14 +83,33 @@ bool check_board(const Board_t * board) {
     ASSERT((board->pieces[SQ120(sq64)] == bP) || (board->pieces[SQ120(sq64)] == wP));
   }
 
+  // validate the bitboards for every piece type against the board
+  uint64_t temp_colors[3] = {0, 0, 0};
+  for(temp_piece = wP; temp_piece <= bK; ++temp_piece) {
+    uint64_t temp_bb = board->piece_bbs[temp_piece];
+    ASSERT(count_bits(temp_bb) == board->piece_num[temp_piece]);
+
+    temp_colors[PIECE_COL[temp_piece]] |= temp_bb;
+    while(temp_bb) {
+      sq64 = pop_bit(&temp_bb);
+      ASSERT(board->pieces[SQ120(sq64)] == temp_piece);
+    }
+  }
+  ASSERT(temp_colors[WHITE] == board->color_bbs[WHITE]);
+  ASSERT(temp_colors[BLACK] == board->color_bbs[BLACK]);
+  ASSERT((temp_colors[WHITE] | temp_colors[BLACK]) == board->color_bbs[BOTH]);
+
   // check the material, piece counts, move, and the hashcode
   ASSERT(temp_material[WHITE] == board->material[WHITE] && temp_material[BLACK] == board->material[BLACK]);
+  ASSERT(temp_psqt_mg[WHITE] == board->psqt_mg[WHITE] && temp_psqt_mg[BLACK] == board->psqt_mg[BLACK]);
+  ASSERT(temp_psqt_eg[WHITE] == board->psqt_eg[WHITE] && temp_psqt_eg[BLACK] == board->psqt_eg[BLACK]);
   ASSERT(temp_min_piece[WHITE] == board->min_pieces[WHITE] && temp_min_piece[BLACK] == board->min_pieces[BLACK]);
   ASSERT(temp_maj_piece[WHITE] == board->maj_pieces[WHITE] && temp_maj_piece[BLACK] == board->maj_pieces[BLACK]);
   ASSERT(temp_big_piece[WHITE] == board->big_pieces[WHITE] && temp_big_piece[BLACK] == board->big_pieces[BLACK]);
 
   ASSERT(board->side == WHITE || board->side == BLACK);
   ASSERT(generate_hashkeys(board) == board->hashkey);
+  ASSERT(generate_pawn_key(board) == board->pawn_key);
 
   // check the en passant value
   // either we don't have one, or if we do and it's white to move then it's on the 6th rank
@@ -118,6 +144,8 @@ void update_material(Board_t *board) {
 
       // set up material values
       board->material[color] += PIECE_VAL[piece];
+      board->psqt_mg[color] += PSQT_MG[piece][SQ64(sq)];
+      board->psqt_eg[color] += PSQT_EG[piece][SQ64(sq)];
 
       // places pieces in the piece list
       board->piece_list[piece][board->piece_num[piece]++] = sq;
@@ -125,6 +153,11 @@ void update_material(Board_t *board) {
       // set up king square
       if(piece == wK || piece == bK) board->kings_sq[color] = sq;
 
+      // put it on the bitboards
+      SETBIT(board->piece_bbs[piece], SQ64(sq));
+      SETBIT(board->color_bbs[color], SQ64(sq));
+      SETBIT(board->color_bbs[BOTH], SQ64(sq));
+
       // handle pawns
       if(piece == wP) {
         SETBIT(board->pawns[WHITE], SQ64(sq));
@@ -141,7 +174,7 @@ void update_material(Board_t *board) {
  * Takes a FEN string and sets up the board accordingly
  * For more info on FEN, see https://en.wikipedia.org/wiki/Forsyth%E2%80%93Edwards_Notation
  */
-bool parse_FEN(char *fen, Board_t *board) {
+bool parse_FEN(const char *fen, Board_t *board) {
   ASSERT(fen);
   ASSERT(board);
 
@@ -326,6 +359,7 @@ bool parse_FEN(char *fen, Board_t *board) {
   }
 
   board->hashkey = generate_hashkeys(board);
+  board->pawn_key = generate_pawn_key(board);
 
   // set the values of the board material up before returning
   update_material(board);
@@ -350,14 +384,20 @@ void reset_board(Board_t *board) {
     board->maj_pieces[ind] = 0;
     board->min_pieces[ind] = 0;
     board->material[ind] = 0;
+    board->psqt_mg[ind] = board->psqt_eg[ind] = 0;
     board->pawns[ind] = (uint64_t)0;
   }
 
   // special case not handled by above loop
   board->pawns[BOTH] = (uint64_t)0;
 
-  for(ind = 0; ind < 13; ++ind)
+  for(ind = 0; ind < 3; ++ind)
+    board->color_bbs[ind] = (uint64_t)0;
+
+  for(ind = 0; ind < 13; ++ind) {
     board->piece_num[ind] = 0;
+    board->piece_bbs[ind] = (uint64_t)0;
+  }
 
   board->kings_sq[WHITE] = board->kings_sq[BLACK] = NO_SQ;
 
@@ -370,4 +410,5 @@ void reset_board(Board_t *board) {
   board->castle_permission = 0;
 
   board->hashkey = (uint64_t)0;
+  board->pawn_key = (uint64_t)0;
 }
@@ -20,6 +20,9 @@ static void print_help(void) {
   printf("depth x - set depth to x\n");
   printf("time x - set thinking time to x seconds (depth still applies if set)\n");
   printf("view - show current depth and movetime settings\n");
+  printf("stats - show how often the pawn table is being hit\n");
+  printf("perft x - count the positions x moves deep from here (and how fast)\n");
+  printf("divide x - same as perft, but also shows the count after each move\n");
   printf("** note ** - to reset time and depth, set to 0\n");
   printf("enter moves using UCI notation\n\n\n");
 }
@@ -35,11 +38,6 @@ void console_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool usin
   info->game_mode = CONSOLEMODE;
   info->post_thinking = true;
 
-  // turn off buffering for stdin and stdout
-  // we did this back in engine.c, but can't hurt to do it again
-  setvbuf(stdin, NULL, _IONBF, 0);
-  setvbuf(stdout, NULL, _IONBF, 0);
-
   // initialize some stuff we'll be using
   int32_t depth = MAX_DEPTH, movetime = 0;
   enum COLORS engine_side = BLACK;
@@ -83,8 +81,8 @@ void console_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool usin
     // reset the input buffer
     memset(in, '\0', XBOARD_BUFFER_SIZE);
 
-    // grab the user string and restart the loop if no input provided
-    if(!fgets(in, XBOARD_BUFFER_SIZE, stdin)) continue;
+    // grab the user string
+    get_input(in, XBOARD_BUFFER_SIZE);
 
     // parse just the command section of the string (no args)
     sscanf(in, "%s", cmd);
@@ -97,7 +95,7 @@ void console_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool usin
 
     // this one is obvious too
     if(!strncmp(cmd, "quit", strlen("quit"))) {
-      info->quit = true;
+      ATOMIC_STORE(info->quit, true);
       break;
     }
 
@@ -108,6 +106,12 @@ void console_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool usin
       continue;
     }
 
+    // print how well the evaluation caches are doing
+    if(!strncmp(cmd, "stats", strlen("stats"))) {
+      print_stats(board);
+      continue;
+    }
+
     // print the board
     if(!strncmp(cmd, "print", strlen("print"))) {
       print_board(board);
@@ -155,9 +159,23 @@ void console_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool usin
       continue;
     }
 
+    // count every position x moves deep from the current one
+    // (divide splits that count up by the first move)
+    if(!strncmp(cmd, "perft", strlen("perft")) || !strncmp(cmd, "divide", strlen("divide"))) {
+      int32_t perft_depth = 0;
+      sscanf(in, "%*s %d", &perft_depth);
+      if(perft_depth < 1) {
+        printf("usage: %s <depth>\n", cmd);
+        continue;
+      }
+      print_perft(perft_depth, board, cmd[0] == 'd', info->threads);
+      continue;
+    }
+
     // reset the game
     if(!strncmp(cmd, "new", strlen("new"))) {
       engine_side = BLACK;
+      clear_hashset(&board->hash_table);
       parse_FEN(START_FEN, board);
       printf("ok, setting up a new game.\n");
       continue;
@@ -27,12 +27,21 @@
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
-#include <sys/select.h>
+#include <pthread.h>
+// for mapping the opening book into memory
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 // for converting endianness of uint16_t and uint64_t
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #endif
 
+// pext instruction for the BMI2 build (see `make notarookie-bmi2`)
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
 #include "enums.h"
 #include "macros.h"
 
@@ -102,8 +111,27 @@ Type 'quit' to exit.\n"
 // you can find more about it here: https://www.chessprogramming.org/Looking_for_Magics
 #define MAGIC_BIT_NUM 0x783A9B23
 
-// initial size of our hashset
-#define HASHSET_SIZE 0x10000000
+// initial size of our hashset, in megabytes
+// can be changed at runtime through the "Hash" option (UCI) or "memory" command (xboard)
+#define HASHSET_SIZE_MB 256
+
+// bounds on the size of the hashset, in megabytes
+#define MIN_HASHSET_SIZE_MB 1
+#define MAX_HASHSET_SIZE_MB 32768
+
+// size of the pawn structure table in megabytes.
+// pawn structures repeat a lot, so this can be a lot smaller than the hashset
+#define PAWN_TABLE_SIZE_MB 4
+
+// most threads the engine will ever spin up at once
+#define MAX_THREADS 64
+
+// default depth and hashset size (in megabytes) for the benchmark (see bench.c)
+#define BENCH_DEPTH 11
+#define BENCH_HASH_MB 16
+
+// default number of times the parse_move benchmark goes through the moves of each position
+#define PARSE_BENCH_ITERATIONS 5000
 
 // size of buffer used for UCI loop.
 // UCI protocol requires that all moves played in total are transmitted
@@ -114,6 +142,9 @@ Type 'quit' to exit.\n"
 // also used in the console loop
 #define XBOARD_BUFFER_SIZE 80
 
+// how many lines the input thread can read ahead of the protocol loops (see util.c)
+#define INPUT_QUEUE_SIZE 16
+
 /**
  *                        MOVE REPRESENTATION
  * this engine will use 32 bit unsigned integers to represent moves.
@@ -145,6 +176,22 @@ Type 'quit' to exit.\n"
 #define MATE 29000
 #define INFINITY 40000
 
+// any score past this is a forced mate. Mate scores get stored in the
+// transposition table relative to the node instead of the root, so we need
+// a way to recognize them
+#define IS_MATE (MATE - MAX_DEPTH)
+
+// half the width of the aspiration window the iterative deepening search starts
+// with (in centipawns), and the depth it kicks in at (see search.c)
+#define ASPIRATION_WINDOW 50
+#define ASPIRATION_DEPTH 4
+
+// late move reductions (see search.c). Quiet moves after the first few at a
+// node get searched with less depth, depending on how deep we are and how
+// late the move comes in the ordering
+#define LMR_MIN_DEPTH 3
+#define LMR_MIN_MOVES 3
+
 // Struct used to store moves so that we can undo moves later (hence the name)
 // For definitions of each member of the struct, see the board representation
 // Note: statuses are for before the move was played
@@ -172,20 +219,56 @@ typedef struct MoveList {
   int32_t count;
 } MoveList_t;
 
-// Entries to our hashset are of this type
-// hold the hashkey for that position as well as the move
-// These are entries that are better than alpha when alpha-beta searching
-typedef struct PVEntry {
-  uint64_t hashkey;
-  uint32_t move;
-} PVEntry_t;
+// hands out the moves of a position one at a time, best guesses first, and only
+// generates moves once it actually runs out of better ones (see movegen.c)
+typedef struct MovePicker {
+
+  MoveList_t list;
+  int32_t stage; // which of PICK_STAGES we're on
+  int32_t index; // next spot in the list to pick from
+  int32_t captures_end; // captures fill the list up to here, quiets go after
+  int32_t bad_captures; // where the captures that lose material start
+  uint32_t tt_move;
+  uint32_t killers[2];
+  bool quiets; // false in quiescence, where we only want the good captures
+} MovePicker_t;
+
+// Entries to our hashset (a.k.a. the transposition table) are of this type
+// hold the hashkey for that position, the best move found there, and
+// the score/depth/bound/age that the search came up with so that we can skip
+// searching the same position twice.
+//
+// Everything but the key is packed into one 64 bit value (see the ENTRY_ macros in
+// macros.h), and the key is stored XORed with that value. Search threads share the
+// table without any locks, so if two threads write the same entry at once the key
+// won't match the data anymore and the entry just looks like a miss. See
+// https://www.chessprogramming.org/Shared_Hash_Table#Lockless for more
+typedef struct HashEntry {
+  uint64_t smp_key; // hashkey ^ data
+  uint64_t data;
+} HashEntry_t;
 
 // Definition of our hashset
 // Contains an array of entries as well as how many entries we have
-typedef struct PVTable {
-  PVEntry_t *table;
+// (always a power of two, so that indexing is just a mask)
+// The age is bumped every search instead of clearing the table, so
+// entries left over from old searches are stale and just get overwritten
+typedef struct HashTable {
+  HashEntry_t *table;
   unsigned long entries;
-} PVTable_t;
+  uint8_t age;
+} HashTable_t;
+
+// Table of pawn structure scores, looked up by the pawn key of the board.
+// Uses the same entries as the hashset (data is just the score), so it can be
+// shared between search threads without locks. The counters are per board though,
+// so they only count lookups made by that board's thread
+typedef struct PawnTable {
+  HashEntry_t *table;
+  unsigned long entries;
+  uint64_t probes;
+  uint64_t hits;
+} PawnTable_t;
 
 // struct for holding relevant search tree info
 typedef struct SearchInfo {
@@ -200,9 +283,23 @@ typedef struct SearchInfo {
 
   long nodes; // count of nodes visited
 
+  // the input thread sets these mid-search, so they only get
+  // read/written with ATOMIC_LOAD/ATOMIC_STORE (see macros.h)
   bool quit; // this is to end the program
   bool stopped; // this is to stop the search
 
+  // searching on the opponent's time. Time limits don't count until the
+  // opponent plays the move we guessed (UCI "ponderhit"). Atomic like the
+  // flags above, the input thread clears it after moving the clock
+  bool pondering;
+  uint32_t ponder_move; // the reply we expect after our best move (NOMOVE if we don't know)
+
+  int32_t threads; // how many threads to search with (Lazy SMP)
+
+  // only set for helper threads: the main thread's info, which is
+  // where the helpers find out that they should stop
+  struct SearchInfo *parent;
+
   // indicators for seeing how good the searching is
   float fail_high;
   float fail_high_first; // found best move first
@@ -214,6 +311,12 @@ typedef struct Board {
   int32_t pieces[BOARD_SQ_NUM]; // the actual board itself, represented as a 1D array
   uint64_t pawns[3]; // bit array where if a bit is set to 1, a pawn is in that spot (one array index per color)
 
+  // same idea as the pawns above, but for every piece type (indexed by the PIECES enum)
+  // and for every piece of a color (WHITE, BLACK, and BOTH for all occupied squares)
+  // these are what move generation and attack detection run off of
+  uint64_t piece_bbs[13];
+  uint64_t color_bbs[3];
+
   int32_t kings_sq[2]; // tels what square the king is on
 
   enum COLORS side; // which side is supposed to move next
@@ -227,6 +330,7 @@ typedef struct Board {
   int32_t castle_permission; // can we castle now?
 
   uint64_t hashkey; // unique key generated for each position generated
+  uint64_t pawn_key; // same idea as the hashkey, but only for the pawns
 
   int32_t piece_num[13]; // 13 instead of 12 cause of EMPTY at pos 0 in the PIECES enum
   int32_t big_pieces[2]; // anything that isn't a pawn
@@ -234,6 +338,11 @@ typedef struct Board {
   int32_t min_pieces[2]; // bishops and knights only
   int32_t material[2]; // holds value of material for black and white
 
+  // running totals of the piece square tables (see evaluate.c) for black and white.
+  // they only differ in which king table is used
+  int32_t psqt_mg[2];
+  int32_t psqt_eg[2];
+
   Undo_t history[MAX_GAME_MOVES];
 
   // 13 instead of 12 cause of EMPTY at pos 0 in the PIECES enum
@@ -241,7 +350,10 @@ typedef struct Board {
   int32_t piece_list[13][10];
 
   // instance of our hashset
-  PVTable_t pvt;
+  HashTable_t hash_table;
+
+  // cached pawn structure scores (see evaluate.c)
+  PawnTable_t pawn_table;
 
   // array of moves stored for a best line
   uint32_t pv_array[MAX_DEPTH];
@@ -256,6 +368,15 @@ typedef struct Board {
 
 } Board_t;
 
+// everything needed to look up the attacks of a sliding piece on one square
+// see bboard.c (and https://www.chessprogramming.org/Magic_Bitboards) for how these work
+typedef struct Magic {
+  uint64_t mask; // squares that can block the piece (board edges don't count)
+  uint64_t magic; // multiplier that maps every blocker setup to a unique index (unused with pext)
+  uint64_t *attacks; // this square's section of the attack table
+  int32_t shift; // how far to shift the product to get the index (unused with pext)
+} Magic_t;
+
 // struct for the entries from the openings book
 typedef struct PolybookEntry {
   uint64_t key; // hashkey for the entry
@@ -266,8 +387,9 @@ typedef struct PolybookEntry {
 
 // struct representing a book
 typedef struct Polybook {
-  PolybookEntry_t *entries; // the entries of the book
+  const PolybookEntry_t *entries; // the entries of the book (mapped read only from the file)
   unsigned long num_entries; // number of entries
+  size_t mapped_size; // length of the file mapping, which is what gets unmapped (0 on windows)
 } Polybook_t;
 
 
@@ -328,10 +450,32 @@ extern uint64_t BLACK_PASSED_MASK[STANDARD_BOARD_SIZE];
 extern uint64_t WHITE_PASSED_MASK[STANDARD_BOARD_SIZE];
 extern uint64_t ISOLATED_MASK[STANDARD_BOARD_SIZE];
 
+// precomputed attacks for the non sliding pieces, indexed by 64 square board index
+// pawn attacks are also indexed by the color of the pawn
+extern uint64_t KNIGHT_ATTACKS[STANDARD_BOARD_SIZE];
+extern uint64_t KING_ATTACKS[STANDARD_BOARD_SIZE];
+extern uint64_t PAWN_ATTACKS[2][STANDARD_BOARD_SIZE];
+
+// piece square tables for every piece, indexed by piece then 64 square index
+// (already flipped for black). defined in evaluate.c
+extern int32_t PSQT_MG[13][STANDARD_BOARD_SIZE];
+extern int32_t PSQT_EG[13][STANDARD_BOARD_SIZE];
+
+// magic lookups for the sliding pieces (see the *_ATTACKS macros in macros.h)
+extern Magic_t ROOK_MAGICS[STANDARD_BOARD_SIZE];
+extern Magic_t BISHOP_MAGICS[STANDARD_BOARD_SIZE];
+
+// squares strictly between two squares, and the whole line through them (both squares
+// included), for squares on the same rank/file/diagonal. Used for pins and blocking checks
+extern uint64_t BETWEEN_BB[STANDARD_BOARD_SIZE][STANDARD_BOARD_SIZE];
+extern uint64_t LINE_BB[STANDARD_BOARD_SIZE][STANDARD_BOARD_SIZE];
+
 // used to create the mirror board for evaluation checking
 extern const int32_t MIRROR_64[STANDARD_BOARD_SIZE];
 
 // defined in consts.c
 extern const uint64_t Random64[781];
+extern const uint64_t ROOK_MAGIC_NUMS[STANDARD_BOARD_SIZE];
+extern const uint64_t BISHOP_MAGIC_NUMS[STANDARD_BOARD_SIZE];
 
 #endif
@@ -240,3 +240,45 @@ const uint64_t Random64[781] = {
    U64(0xCF3145DE0ADD4289), U64(0xD0E4427A5514FB72), U64(0x77C621CC9FB3A483), U64(0x67A34DAC4356550B),
    U64(0xF8D626AAAF278509),
 };
+
+// magic numbers for looking up rook and bishop attacks, indexed by 64 square board index.
+// these were found by trying random numbers with few bits set until every blocker setup
+// for the square mapped to its own index (see init_magics in bboard.c).
+// storing them here saves us from doing that search every time the engine starts up
+const uint64_t ROOK_MAGIC_NUMS[STANDARD_BOARD_SIZE] = {
+  U64(0x008000908064C000), U64(0x0040200040001000), U64(0x0180100080A0010A), U64(0x8880041000800800),
+  U64(0x1200100201200804), U64(0x0200020004011008), U64(0x2180010000800600), U64(0x0200005088210204),
+  U64(0x0400800040008021), U64(0x0400400020005000), U64(0x8240801000200080), U64(0x8611001004200900),
+  U64(0x008180800C001800), U64(0x0100800200800400), U64(0x0A02000102000408), U64(0x8020802300104280),
+  U64(0x0080004000402000), U64(0xE010104000402000), U64(0x0800808010002000), U64(0xA280210008100100),
+  U64(0x0001818014000800), U64(0xA002010100080400), U64(0x0080240001020870), U64(0x0001020004048845),
+  U64(0x0081826280004004), U64(0x2020810900284000), U64(0x0200100080802000), U64(0x0200080080100080),
+  U64(0x8083080100100500), U64(0x4406000901000400), U64(0x0005020080800100), U64(0x0090204200008114),
+  U64(0x0010400094800420), U64(0x0900804000802002), U64(0x0201001841002000), U64(0x4100080080801000),
+  U64(0x4540040080800800), U64(0x0002001004040020), U64(0x0281195814001002), U64(0x1240800040800100),
+  U64(0x0880042000524004), U64(0x02C080410206002C), U64(0x0801200241050010), U64(0x8400080010008080),
+  U64(0x0008000500090010), U64(0x0082009084020008), U64(0x4012000108020004), U64(0x9000104D08860004),
+  U64(0x2004204114800100), U64(0x0148802112400300), U64(0x0202842000100880), U64(0x001B080080900080),
+  U64(0x001A002008100600), U64(0x0004008004020080), U64(0x5181000600040300), U64(0x0000044401128A00),
+  U64(0x8044110480002441), U64(0x2008110084402202), U64(0x90806005090010C1), U64(0x000420310A004A42),
+  U64(0x0023001004020801), U64(0x0882001008040102), U64(0x000230088118020C), U64(0x0000019025040042)
+};
+
+const uint64_t BISHOP_MAGIC_NUMS[STANDARD_BOARD_SIZE] = {
+  U64(0x0045010808008680), U64(0x2002080204004898), U64(0x0210009A10400006), U64(0x0824050200810200),
+  U64(0x0006061105004090), U64(0x00010108C0000000), U64(0x0814040282104004), U64(0x0012012201106800),
+  U64(0x10823014100C1040), U64(0x0080C2088802808C), U64(0x0281108410404000), U64(0x0101212041826200),
+  U64(0x0020141028221058), U64(0x2201020202200202), U64(0x000082A801482000), U64(0x0000008401411044),
+  U64(0x0007103014300404), U64(0x0002091110010100), U64(0x42140012040C0808), U64(0x0800808802004020),
+  U64(0x90C4004210140000), U64(0x0800200900A01000), U64(0x00D0400201108810), U64(0x80820183814412A0),
+  U64(0x00A01008202202B4), U64(0x01C2021A09500402), U64(0x0084440208042400), U64(0x800400400C090100),
+  U64(0xBA10040010802100), U64(0xD182009006005000), U64(0x5011021001009004), U64(0x0020420200510400),
+  U64(0x0292104000468800), U64(0x00043009091C0500), U64(0x0280441000020025), U64(0x0042820080080080),
+  U64(0x0440101010010040), U64(0x1000900100808080), U64(0x0108108120089800), U64(0x0044010200012682),
+  U64(0xC002500420900400), U64(0x0040482210710800), U64(0x0002060024000200), U64(0x0281020A44000800),
+  U64(0xA0021200A4000200), U64(0x0001301000840840), U64(0x2868500108444220), U64(0x0004111041000200),
+  U64(0x8044020842080200), U64(0x0000220104210200), U64(0x0000021201044000), U64(0x0000280884040028),
+  U64(0x4012114010858003), U64(0x0000081004082B88), U64(0x3892700508208002), U64(0x00220A041B060400),
+  U64(0x0812020284014881), U64(0x010434A282103100), U64(0x0490400824020800), U64(0x4A20002C00208800),
+  U64(0x000000A011020200), U64(0x4002940A02482202), U64(0x5100100202140406), U64(0x02102000840540C1)
+};
@@ -12,15 +12,22 @@
  */
 int main(int argc, char *argv[]) {
 
+  // `notarookie bench [depth] [threads] [hash MB]` runs the benchmark instead (see bench.c)
+  // and `notarookie parsebench [iterations]` the parse_move one
+  bool parse_benching = argc >= 2 && !strcmp(argv[1], "parsebench");
+  bool benching = (argc >= 2 && !strcmp(argv[1], "bench")) || parse_benching;
+
   // check argument number
-  if(argc >= 3) {
+  if(argc >= 3 && !benching) {
     fprintf(stderr, "Too many arguments supplied.\n");
     exit(1);
   }
 
-  // turn off buffering for stdin and stdout
-  setvbuf(stdin, NULL, _IONBF, 0);
-  setvbuf(stdout, NULL, _IONBF, 0);
+  // everything printed piles up in stdout's buffer and goes out in one write
+  // when we flush, which happens once a line the GUI is waiting on is done
+  // (bestmove, readyok, ...) and whenever we go back to waiting for input.
+  // Unbuffered, every single printf would be its own write
+  setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
 
   // seed the pseudorandom number generator used in polybook.c
   // and initialize
@@ -30,7 +37,7 @@ int main(int argc, char *argv[]) {
   // set up the openings book
   bool using_book = false;
   char *bookstr;
-  if(argc == 2) {
+  if(argc == 2 && !benching) {
     // set this to be whatever openings book you want
     // found in the `books` directory.
     bookstr = argv[1];
@@ -42,19 +49,52 @@ int main(int argc, char *argv[]) {
   SearchInfo_t info;
   Polybook_t book;
 
-  info.quit = false;
-  board.pvt.table = NULL;
-  init_hashset(&board.pvt); // initialize the principle variation table in the board
+  ATOMIC_STORE(info.quit, false);
+  ATOMIC_STORE(info.pondering, false);
+  info.threads = 1;
+  info.parent = NULL;
+  board.hash_table.table = NULL;
+  board.pawn_table.table = NULL;
+  // initialize the transposition table and pawn table in the board
+  if(!init_hashset(&board.hash_table, HASHSET_SIZE_MB)) exit(1);
+  if(!init_pawn_table(&board.pawn_table, PAWN_TABLE_SIZE_MB)) exit(1);
 
   // if we have a book file provided, try to initialize it
   if(using_book) using_book = init_polybook(&book, bookstr);
 
-  printf(WELCOME_STR, NAME);
+  if(parse_benching) {
+    int32_t iterations = (argc > 2) ? atoi(argv[2]) : PARSE_BENCH_ITERATIONS;
+    if(iterations < 1) iterations = 1;
+
+    bench_parse_move(&board, iterations);
+    ATOMIC_STORE(info.quit, true);
+  } else if(benching) {
+    int32_t depth = (argc > 2) ? atoi(argv[2]) : BENCH_DEPTH;
+    int32_t threads = (argc > 3) ? atoi(argv[3]) : 1;
+    int32_t megabytes = (argc > 4) ? atoi(argv[4]) : BENCH_HASH_MB;
+
+    if(depth < 1) depth = 1;
+    if(depth > MAX_DEPTH) depth = MAX_DEPTH;
+    if(threads < 1) threads = 1;
+    if(threads > MAX_THREADS) threads = MAX_THREADS;
+    if(megabytes < MIN_HASHSET_SIZE_MB) megabytes = MIN_HASHSET_SIZE_MB;
+    if(megabytes > MAX_HASHSET_SIZE_MB) megabytes = MAX_HASHSET_SIZE_MB;
+
+    bench(&board, &info, depth, threads, megabytes);
+    ATOMIC_STORE(info.quit, true); // skip the protocol loop and go straight to cleaning up
+  }
+
+  if(!ATOMIC_LOAD(info.quit)) {
+    printf(WELCOME_STR, NAME);
+
+    // from here on out, stdin is read by its own thread (see util.c)
+    start_input_thread(&info);
+  }
 
   // set up input buffer
   char line[BUFSIZ];
 
-  while(true) {
+  while(!ATOMIC_LOAD(info.quit)) {
     // this loop pretty much never gets run more than once, but
     // still we should reset the line
     memset(line, '\0', BUFSIZ);
@@ -62,21 +102,21 @@ int main(int argc, char *argv[]) {
     fflush(stdout);
 
     // grab user input/GUI input
-    if(!fgets(line, BUFSIZ, stdin)) continue;
+    get_input(line, BUFSIZ);
     if(*line == '\n') continue;
 
     // select which protocol to use
     if(!strncmp(line, "uci", strlen("uci"))) {
       UCI_loop(&board, &info, book, using_book);
-      if(info.quit) break;
+      if(ATOMIC_LOAD(info.quit)) break;
       continue;
     } else if(!strncmp(line, "xboard", strlen("xboard"))) {
       XBoard_loop(&board, &info, book, using_book);
-      if(info.quit) break;
+      if(ATOMIC_LOAD(info.quit)) break;
       continue;
     } else if(!strncmp(line, "console", strlen("console"))) {
       console_loop(&board, &info, book, using_book);
-      if(info.quit) break;
+      if(ATOMIC_LOAD(info.quit)) break;
       continue;
     } else if(!strncmp(line, "quit", strlen("quit"))) {
       break;
@@ -85,8 +125,10 @@ int main(int argc, char *argv[]) {
 
 
   // clean up any memory we allocated
-  free(board.pvt.table);
-  board.pvt.table = NULL;
+  free(board.hash_table.table);
+  board.hash_table.table = NULL;
+  free(board.pawn_table.table);
+  board.pawn_table.table = NULL;
   if(using_book) clean_polybook(&book);
 
   return EXIT_SUCCESS;
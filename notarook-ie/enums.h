@@ -20,7 +20,8 @@ enum RANKS { RANK_1, RANK_2, RANK_3, RANK_4, RANK_5, RANK_6, RANK_7, RANK_8, RAN
 enum COLORS { WHITE, BLACK, BOTH };
 
 /* Next enum is for modes supported by the engine */
-enum MODES { UCIMODE, XBOARDMODE, CONSOLEMODE };
+/* (bench mode is the benchmark, which just searches and keeps quiet) */
+enum MODES { UCIMODE, XBOARDMODE, CONSOLEMODE, BENCHMODE };
 
 /* next up are the board squares */
 /* Note that OFFBOARD isn't strictly necessary (it's the same as NO_SQ) */
@@ -36,6 +37,14 @@ enum BOARD_SQUARES {
   A8 = 91, B8, C8, D8, E8, F8, G8, H8, NO_SQ, OFFBOARD
 };
 
+/* what kind of score is stored in a hash entry */
+/* alpha -> upper bound (no move beat alpha), beta -> lower bound (cutoff), exact -> PV node */
+enum HASH_FLAGS { HFNONE, HFALPHA, HFBETA, HFEXACT };
+
+/* stages the move picker goes through, in order (see movegen.c) */
+enum PICK_STAGES { PICK_TT, PICK_GEN_CAPTURES, PICK_CAPTURES, PICK_KILLER_1, PICK_KILLER_2,
+                   PICK_GEN_QUIETS, PICK_QUIETS, PICK_BAD_CAPTURES, PICK_DONE };
+
 /* for castling purposes */
 /* maps to the castle_permission 32 bit int in the board */
 enum CASTLING { WKCAS = 1, WQCAS = 2, BKCAS = 4, BQCAS = 8 };
@@ -85,6 +85,39 @@ static const int32_t KING_O[STANDARD_BOARD_SIZE] = {
  -70 , -70 , -70 , -70 , -70 , -70 , -70 , -70
 };
 
+// the above tables combined for every piece, filled in by init_psqt.
+// the board keeps a running total of these as pieces move (see makemove.c)
+// so the evaluation doesn't have to add them all up every time.
+// MG uses the opening king table and EG uses the endgame one, everything
+// else is the same in both
+int32_t PSQT_MG[13][STANDARD_BOARD_SIZE];
+int32_t PSQT_EG[13][STANDARD_BOARD_SIZE];
+
+/**
+ * Fills in the combined piece square tables. Tables are written from white's
+ * point of view, so black pieces look them up with the square mirrored.
+ * Queens (and empty squares) don't have a table so they stay 0
+ */
+void init_psqt(void) {
+  for(int32_t sq64 = 0; sq64 < STANDARD_BOARD_SIZE; ++sq64) {
+    int32_t mirror = MIRROR64(sq64);
+
+    PSQT_MG[wP][sq64] = PSQT_EG[wP][sq64] = PAWN_TABLE[sq64];
+    PSQT_MG[bP][sq64] = PSQT_EG[bP][sq64] = PAWN_TABLE[mirror];
+    PSQT_MG[wN][sq64] = PSQT_EG[wN][sq64] = KNIGHT_TABLE[sq64];
+    PSQT_MG[bN][sq64] = PSQT_EG[bN][sq64] = KNIGHT_TABLE[mirror];
+    PSQT_MG[wB][sq64] = PSQT_EG[wB][sq64] = BISHOP_TABLE[sq64];
+    PSQT_MG[bB][sq64] = PSQT_EG[bB][sq64] = BISHOP_TABLE[mirror];
+    PSQT_MG[wR][sq64] = PSQT_EG[wR][sq64] = ROOK_TABLE[sq64];
+    PSQT_MG[bR][sq64] = PSQT_EG[bR][sq64] = ROOK_TABLE[mirror];
+
+    PSQT_MG[wK][sq64] = KING_O[sq64];
+    PSQT_EG[wK][sq64] = KING_E[sq64];
+    PSQT_MG[bK][sq64] = KING_O[mirror];
+    PSQT_EG[bK][sq64] = KING_E[mirror];
+  }
+}
+
 // have a negative reward for isolated pawns to discourage the
 // engine from leaving these
 static const int32_t pawn_isolated = -10;
@@ -157,27 +190,12 @@ static bool material_draw(const Board_t *board) {
 }
 
 /**
- * This function takes in a position on the board
- * and returns the evaluation of the position in
- * 100s of a pawn from the point of view of the side to move
- * white == positive, black == negative. we negate at the end if black is to move
+ * Scores the isolated and passed pawns from white's point of view.
+ * This only depends on where the pawns are
  */
-int32_t eval_position(const Board_t * board) {
-
+static int32_t score_pawns(const Board_t *board) {
   int32_t piece, square;
-
-  // to start, we just subtract the balance of pieces
-  int32_t score = board->material[WHITE] - board->material[BLACK];
-
-  // if our position is drawn purely by material, return so
-  // for this, we need to know that we have no pawns at all on the board
-  if(!board->piece_num[wP] && !board->piece_num[bP] && material_draw(board)) return 0;
-
-  /*
-   * next section is piece specific score manipulation
-   * we loop through the number of each piece on the board and use the
-   * above tables to add/subtract from the score
-   */
+  int32_t score = 0;
 
   // white pawns first
   piece = wP;
@@ -186,9 +204,6 @@ int32_t eval_position(const Board_t * board) {
     square = board->piece_list[piece][idx];
     ASSERT(square_on_board(square));
 
-    // add/subtract from the score given the position of the pawn
-    score += PAWN_TABLE[SQ64(square)];
-
     // check for isolated pawns and deduct from the score if we have them
     if(!(ISOLATED_MASK[SQ64(square)] & board->pawns[WHITE])) {
       score += pawn_isolated;
@@ -209,9 +224,6 @@ int32_t eval_position(const Board_t * board) {
     square = board->piece_list[piece][idx];
     ASSERT(square_on_board(square));
 
-    // add/subtract from the score given the position of the pawn
-    score -= PAWN_TABLE[MIRROR64(SQ64(square))];
-
     // check for isolated pawns and add to the score if we have them
     if(!(ISOLATED_MASK[SQ64(square)] & board->pawns[BLACK])) {
       score -= pawn_isolated;
@@ -227,54 +239,88 @@ int32_t eval_position(const Board_t * board) {
     }
   }
 
-  // r/whiteknighting
-  piece = wN;
-  for(int32_t idx = 0; idx < board->piece_num[piece]; ++idx) {
-    // get and verify which square the current piece is on
-    square = board->piece_list[piece][idx];
-    ASSERT(square_on_board(square));
-    // add/subtract from the score given the position of the knight
-    score += KNIGHT_TABLE[SQ64(square)];
-  }
+  return score;
+}
 
-  // black knights
-  piece = bN;
-  for(int32_t idx = 0; idx < board->piece_num[piece]; ++idx) {
-    // get and verify which square the current piece is on
-    square = board->piece_list[piece][idx];
-    ASSERT(square_on_board(square));
-    // add/subtract from the score given the position of the knight
-    score -= KNIGHT_TABLE[MIRROR64(SQ64(square))];
-  }
+/**
+ * Looks up the pawn structure score in the board's pawn table, and works it out
+ * (and stores it) if it's not there. Pawns don't move very often compared to everything
+ * else, so most positions in the search share their pawn structure with one we've
+ * already seen. Uses the same lockless trick as the hashset since the table is
+ * shared between search threads
+ */
+static int32_t eval_pawn_structure(Board_t *board) {
+  PawnTable_t *pt = &board->pawn_table;
 
-  // white bishops
-  piece = wB;
-  for(int32_t idx = 0; idx < board->piece_num[piece]; ++idx) {
-    // get and verify which square the current piece is on
-    square = board->piece_list[piece][idx];
-    ASSERT(square_on_board(square));
-    // add/subtract from the score given the position of the bishop
-    score += BISHOP_TABLE[SQ64(square)];
-  }
+  // no table (e.g. the stresstest program), just work it out
+  if(!pt->table) return score_pawns(board);
 
-  // black bishops
-  piece = bB;
-  for(int32_t idx = 0; idx < board->piece_num[piece]; ++idx) {
-    // get and verify which square the current piece is on
-    square = board->piece_list[piece][idx];
-    ASSERT(square_on_board(square));
-    // add/subtract from the score given the position of the bishop
-    score -= BISHOP_TABLE[MIRROR64(SQ64(square))];
+  HashEntry_t *entry = &pt->table[board->pawn_key & (pt->entries - 1)];
+  uint64_t data = entry->data;
+  pt->probes++;
+
+  if((entry->smp_key ^ data) == board->pawn_key) {
+    pt->hits++;
+    return (int32_t)(uint32_t)data;
   }
 
+  int32_t score = score_pawns(board);
+  data = (uint64_t)(uint32_t)score;
+  entry->data = data;
+  entry->smp_key = board->pawn_key ^ data;
+  return score;
+}
+
+/**
+ * Prints out how well the caches used by the evaluation are doing
+ */
+void print_stats(const Board_t *board) {
+  const PawnTable_t *pt = &board->pawn_table;
+  double rate = pt->probes ? 100.0 * (double)pt->hits / (double)pt->probes : 0.0;
+
+  printf("pawn table: %lu entries, %llu probes, %llu hits (%.1f%% hit rate)\n", pt->entries,
+         (unsigned long long)pt->probes, (unsigned long long)pt->hits, rate);
+}
+
+/**
+ * This function takes in a position on the board
+ * and returns the evaluation of the position in
+ * 100s of a pawn from the point of view of the side to move
+ * white == positive, black == negative. we negate at the end if black is to move
+ */
+int32_t eval_position(Board_t * board) {
+
+  int32_t piece, square;
+
+  // to start, we just subtract the balance of pieces
+  int32_t score = board->material[WHITE] - board->material[BLACK];
+
+  // if our position is drawn purely by material, return so
+  // for this, we need to know that we have no pawns at all on the board
+  if(!board->piece_num[wP] && !board->piece_num[bP] && material_draw(board)) return 0;
+
+  /*
+   * the piece square tables are kept up to date by the board as pieces move.
+   * each king uses the endgame table once the other side is down to endgame material
+   */
+  score += (board->material[BLACK] <= ENDGAME_MAT) ? board->psqt_eg[WHITE] : board->psqt_mg[WHITE];
+  score -= (board->material[WHITE] <= ENDGAME_MAT) ? board->psqt_eg[BLACK] : board->psqt_mg[BLACK];
+
+  // pawn structure (isolated and passed pawns), cached in the pawn table
+  score += eval_pawn_structure(board);
+
+  /*
+   * next section is piece specific score manipulation
+   * we loop through the rooks and queens on the board and
+   * look at the pawns around them
+   */
+
   // white rooks
   piece = wR;
   for(int32_t idx = 0; idx < board->piece_num[piece]; ++idx) {
     // get and verify which square the current piece is on
     square = board->piece_list[piece][idx];
     ASSERT(square_on_board(square));
-    // add/subtract from the score given the position of the rook
-    score += ROOK_TABLE[SQ64(square)];
 
     // check for open files
     if(!(board->pawns[BOTH] & FILE_BB_MASK[FILES_BOARD[square]])) {
@@ -291,8 +337,6 @@ int32_t eval_position(const Board_t * board) {
     // get and verify which square the current piece is on
     square = board->piece_list[piece][idx];
     ASSERT(square_on_board(square));
-    // add/subtract from the score given the position of the rook
-    score -= ROOK_TABLE[MIRROR64(SQ64(square))];
 
     // check for open files
     if(!(board->pawns[BOTH] & FILE_BB_MASK[FILES_BOARD[square]])) {
@@ -335,27 +379,6 @@ int32_t eval_position(const Board_t * board) {
     }
   }
 
-  // handle kings
-  piece = wK;
-  square = board->piece_list[piece][0];
-
-  // check if we should use the endgame table or the normal table
-  if(board->material[BLACK] <= ENDGAME_MAT) {
-    score += KING_E[SQ64(square)];
-  } else {
-    score += KING_O[SQ64(square)];
-  }
-
-  piece = bK;
-  square = board->piece_list[piece][0];
-
-  // check if we should use the endgame table or the normal table
-  if(board->material[WHITE] <= ENDGAME_MAT) {
-    score -= KING_E[MIRROR64(SQ64(square))];
-  } else {
-    score -= KING_O[MIRROR64(SQ64(square))];
-  }
-
   // check for bishop pairs
   if(board->piece_num[wB] >= 2) score += bishop_pair;
   if(board->piece_num[bB] >= 2) score -= bishop_pair;
@@ -18,18 +18,22 @@ extern void init_all(void);
 /* bboard.c */
 extern int32_t pop_bit(uint64_t *);
 extern int32_t count_bits(uint64_t);
+extern void init_bitboards(void);
 
 /* hashkey.c */
 extern uint64_t generate_hashkeys(const Board_t *);
+extern uint64_t generate_pawn_key(const Board_t *);
 
 /* board.c */
 extern void reset_board(Board_t *);
-extern bool parse_FEN(char *, Board_t *);
+extern bool parse_FEN(const char *, Board_t *);
 extern void update_material(Board_t *);
 extern bool check_board(const Board_t *);
 
 /* attack.c */
 extern bool square_attacked(const int32_t, const int32_t, const Board_t *);
+extern uint64_t attackers_to(const Board_t *, const int32_t, const uint64_t);
+extern int32_t static_exchange(const Board_t *, const uint32_t);
 
 /* printer.c */
 extern char * print_square(const int32_t);
@@ -37,11 +41,17 @@ extern char * print_move(const uint32_t);
 extern void print_bboard(const uint64_t);
 extern void print_board(const Board_t *);
 extern char * print_algebraic_move(const uint32_t, Board_t *);
-extern uint32_t parse_move(char *, Board_t *);
+extern uint32_t parse_move(const char *, const Board_t *);
 
 /* movegen.c */
 extern void generate_all_moves(const Board_t *, MoveList_t *);
 extern void generate_all_captures(const Board_t *, MoveList_t *);
+extern void init_move_picker(const Board_t *, MovePicker_t *, const uint32_t, const bool);
+extern uint32_t next_move(const Board_t *, MovePicker_t *);
+extern void legal_masks(const Board_t *, uint64_t *, uint64_t *);
+extern uint32_t find_move(const Board_t *, const int32_t, const int32_t, const int32_t);
+extern uint32_t find_move_masked(const Board_t *, const int32_t, const int32_t, const int32_t,
+                                 const uint64_t, const uint64_t);
 extern void init_MVV_LVA(void);
 
 /* validation.c */
@@ -59,24 +69,35 @@ extern void make_null_move(Board_t *);
 extern void take_null_move(Board_t *);
 
 /* perft.c */
-extern uint64_t perft_test(int32_t, Board_t *, bool);
+extern uint64_t perft_test(int32_t, Board_t *, bool, int32_t, HashTable_t *);
+extern void print_perft(int32_t, Board_t *, bool, int32_t);
 
 /* search.c */
+extern void init_reductions(void);
 extern void search_position(Board_t *, SearchInfo_t *, bool, const Polybook_t);
 
 /* util.c */
 extern unsigned long get_time_millis(void);
-extern void read_input(SearchInfo_t *);
+extern void start_input_thread(SearchInfo_t *);
+extern void get_input(char *, const int32_t);
+extern void input_search_started(void);
+extern void input_search_stopped(void);
+extern void wait_for_ponder_end(SearchInfo_t *);
+extern void check_input(void);
 
 /* hashset.c */
-extern void init_hashset(PVTable_t *);
-extern void clear_hashset(PVTable_t *);
-extern void store_move(Board_t *, const uint32_t);
-extern uint32_t find_move(const Board_t *);
+extern bool init_hashset(HashTable_t *, const int32_t);
+extern void clear_hashset(HashTable_t *);
+extern bool init_pawn_table(PawnTable_t *, const int32_t);
+extern void store_hash_entry(Board_t *, const uint32_t, int32_t, const int32_t, const int32_t);
+extern bool probe_hash_entry(const Board_t *, uint32_t *, int32_t *, const int32_t, const int32_t, const int32_t);
+extern uint32_t probe_pv_move(const Board_t *);
 extern int32_t get_pv_line(const int32_t, Board_t *);
 
 /* evaluate.c */
-extern int32_t eval_position(const Board_t *);
+extern void init_psqt(void);
+extern int32_t eval_position(Board_t *);
+extern void print_stats(const Board_t *);
 
 /* uci.c */
 extern void UCI_loop(Board_t *, SearchInfo_t *, Polybook_t, bool);
@@ -88,6 +109,10 @@ extern bool check_result(Board_t *);
 /* console.c */
 extern void console_loop(Board_t *, SearchInfo_t *, Polybook_t, bool);
 
+/* bench.c */
+extern void bench(Board_t *, SearchInfo_t *, int32_t, int32_t, int32_t);
+extern void bench_parse_move(Board_t *, int32_t);
+
 /* polybook.c */
 extern void clean_polybook(Polybook_t *);
 extern bool init_polybook(Polybook_t *, char *);
@@ -45,3 +45,18 @@ uint64_t generate_hashkeys(const Board_t *board) {
 
   return result;
 }
+
+/**
+ * Generates the key for just the pawns on the board,
+ * used to look up the pawn structure in the pawn table
+ */
+uint64_t generate_pawn_key(const Board_t *board) {
+  uint64_t result = 0;
+
+  for(int32_t sq = 0; sq < BOARD_SQ_NUM; ++sq) {
+    int32_t piece = board->pieces[sq];
+    if(piece == wP || piece == bP) result ^= PIECE_KEYS[piece][sq];
+  }
+
+  return result;
+}
@@ -1,5 +1,6 @@
 /**
- * Defines a hashmap for use in finding principal variations.
+ * Defines a hashmap (the transposition table) for use in finding principal
+ * variations and for skipping positions we've already searched deep enough.
  * This speeds up the search process _dramatically_.
  *
  * Now is when I wish I did this project in python or C++
@@ -17,7 +18,7 @@ int32_t get_pv_line(const int32_t depth, Board_t *board) {
   ASSERT(depth < MAX_DEPTH);
 
   // grab the move for this position from the PV table
-  uint32_t move = find_move(board);
+  uint32_t move = probe_pv_move(board);
   int32_t count = 0; // number of moves we're putting into the array
 
   while(move != NOMOVE && count < depth) {
@@ -31,7 +32,7 @@ int32_t get_pv_line(const int32_t depth, Board_t *board) {
     } else {
       break; // illegal move
     }
-    move = find_move(board);
+    move = probe_pv_move(board);
   }
 
   // take back all of our "played" moves
@@ -43,60 +44,223 @@ int32_t get_pv_line(const int32_t depth, Board_t *board) {
 }
 
 /**
- * Initializes a hashset via output parameter
+ * Initializes (or resizes) a hashset via output parameter.
+ * The number of entries is the biggest power of two that fits in the given
+ * number of megabytes. If the new table can't be allocated, the old one (if any)
+ * is kept and false is returned
  */
-void init_hashset(PVTable_t *pvt) {
+bool init_hashset(HashTable_t *ht, const int32_t megabytes) {
 
   // how many entries can we hold
-  pvt->entries = HASHSET_SIZE / sizeof(PVEntry_t);
+  unsigned long max_entries = ((unsigned long)megabytes * 0x100000) / sizeof(HashEntry_t);
+  unsigned long entries = 1;
+  while(entries * 2 <= max_entries) entries *= 2;
 
-  // double check this, may run into memory issues
-  if(pvt->table) {
-    free(pvt->table);
+  // allocate the new table before getting rid of the old one, that
+  // way a failed resize doesn't leave us with no table at all
+  HashEntry_t *table = calloc(entries, sizeof(HashEntry_t));
+  if(!table) {
+    fprintf(stderr, "failed to allocate a %dMB hashset.\n", megabytes);
+    return false;
   }
 
-  pvt->table = calloc(pvt->entries, sizeof(PVEntry_t));
+  free(ht->table);
+  ht->table = table;
+  ht->entries = entries;
+  ht->age = 0;
+  return true;
 }
 
 /**
- * Zeros out a given hashset
+ * Initializes the pawn table via output parameter.
+ * Just like the hashset, it gets the biggest power of two entries that fits
+ * in the given number of megabytes
  */
-void clear_hashset(PVTable_t *pvt) {
-  for(unsigned long index = 0; index < pvt->entries; ++index) {
-    pvt->table[index].hashkey = (uint64_t)0;
-    pvt->table[index].move = NOMOVE;
+bool init_pawn_table(PawnTable_t *pt, const int32_t megabytes) {
+  unsigned long max_entries = ((unsigned long)megabytes * 0x100000) / sizeof(HashEntry_t);
+  unsigned long entries = 1;
+  while(entries * 2 <= max_entries) entries *= 2;
+
+  HashEntry_t *table = calloc(entries, sizeof(HashEntry_t));
+  if(!table) {
+    fprintf(stderr, "failed to allocate a %dMB pawn table.\n", megabytes);
+    return false;
+  }
+
+  free(pt->table);
+  pt->table = table;
+  pt->entries = entries;
+  pt->probes = pt->hits = 0;
+  return true;
+}
+
+// chunk of the hashset that one thread zeros out in clear_hashset
+typedef struct ClearSlice {
+  HashEntry_t *start;
+  unsigned long count;
+} ClearSlice_t;
+
+/**
+ * Thread function that zeros out one slice of the hashset
+ */
+static void *clear_slice(void *arg) {
+  ClearSlice_t *slice = (ClearSlice_t *)arg;
+  memset(slice->start, 0, slice->count * sizeof(HashEntry_t));
+  return NULL;
+}
+
+/**
+ * Zeros out a given hashset.
+ * This is only done for a new game (searches just bump the age instead), and the
+ * table is big enough that we split the work up over every core we have.
+ */
+void clear_hashset(HashTable_t *ht) {
+  ht->age = 0;
+
+#ifndef WIN32
+
+  long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if(num_threads < 1) num_threads = 1;
+  if(num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+
+  pthread_t threads[MAX_THREADS];
+  bool started[MAX_THREADS];
+  ClearSlice_t slices[MAX_THREADS];
+  unsigned long per_thread = ht->entries / num_threads;
+
+  // hand out the slices, with the last thread picking up the leftovers
+  for(long idx = 0; idx < num_threads; ++idx) {
+    slices[idx].start = ht->table + idx * per_thread;
+    slices[idx].count = (idx == num_threads - 1) ? ht->entries - idx * per_thread : per_thread;
+
+    // if we can't get a thread, just do the work ourselves
+    started[idx] = !pthread_create(&threads[idx], NULL, clear_slice, &slices[idx]);
+    if(!started[idx]) clear_slice(&slices[idx]);
   }
+
+  for(long idx = 0; idx < num_threads; ++idx) {
+    if(started[idx]) pthread_join(threads[idx], NULL);
+  }
+
+#else
+
+  memset(ht->table, 0, ht->entries * sizeof(HashEntry_t));
+
+#endif
 }
 
 /**
- * Uses the unique hashkey to store a move into the hashset.
+ * Uses the unique hashkey to store a search result into the hashset.
  * This "hash function" isn't perfect for two reasons:
  * 1. It's unlikely, but it's not impossible for two different board positions
  * to have the same hashkey (we'd need to do a formal proof to prove that this isn't true)
- * 2. Two different hashkeys % the size could map to the same spot in the table.
+ * 2. Two different hashkeys masked by the size could map to the same spot in the table.
  * We cross those bridges when/if we get there, though.
  */
-void store_move(Board_t *board, const uint32_t move) {
+void store_hash_entry(Board_t *board, const uint32_t move, int32_t score, const int32_t flags, const int32_t depth) {
   // grab our index and verify it
-  unsigned long index = board->hashkey % (board->pvt.entries);
-  ASSERT(index >= 0 && index < board->pvt.entries);
+  unsigned long index = board->hashkey & (board->hash_table.entries - 1);
+  ASSERT(index >= 0 && index < board->hash_table.entries);
+  ASSERT(depth >= 0);
+  ASSERT(flags >= HFALPHA && flags <= HFEXACT);
+  ASSERT(score >= -INFINITY && score <= INFINITY);
+  ASSERT(board->ply >= 0 && board->ply < MAX_DEPTH);
+
+  // mate scores come in as "mate in x plies from the root", but this position
+  // can be reached at a different ply later, so store it as "mate in x plies from here"
+  if(score > IS_MATE) score += board->ply;
+  else if(score < -IS_MATE) score -= board->ply;
+
+  HashEntry_t *entry = &board->hash_table.table[index];
+
+  // grab the entry once; another thread could be writing it as we go
+  uint64_t old_data = entry->data;
+  uint64_t old_key = entry->smp_key ^ old_data;
+
+  // don't throw away a deeper search of some other position from this search.
+  // anything stored by an older search is fair game though
+  if(old_key != board->hashkey && ENTRY_AGE(old_data) == board->hash_table.age && ENTRY_DEPTH(old_data) > depth) return;
+
+  // the depth only gets 8 bits, and searches that deep never happen anyways
+  uint64_t data = PACK_ENTRY(move, score, (depth > 0xFF) ? 0xFF : depth, flags, board->hash_table.age);
+
+  // store the result at that section
+  entry->smp_key = board->hashkey ^ data;
+  entry->data = data;
+}
+
+/**
+ * Essentially the inverse of the above function.
+ * Fills in the stored move for the position (for move ordering) and returns true
+ * if the stored score was searched deep enough to be used instead of searching again.
+ * Score is an output param, set to the score to return in that case.
+ */
+bool probe_hash_entry(const Board_t *board, uint32_t *move, int32_t *score, const int32_t alpha, const int32_t beta, const int32_t depth) {
+  // grab our index and verify it
+  unsigned long index = board->hashkey & (board->hash_table.entries - 1);
+  ASSERT(index >= 0 && index < board->hash_table.entries);
+  ASSERT(depth >= 1);
+  ASSERT(alpha < beta);
+
+  const HashEntry_t *entry = &board->hash_table.table[index];
+
+  // copy the entry out before checking it since other threads
+  // could be writing to it while we look
+  uint64_t data = entry->data;
+
+  // different position (or nothing, or a half written entry) stored here
+  if((entry->smp_key ^ data) != board->hashkey) return false;
+
+  *move = ENTRY_MOVE(data);
+
+  // the stored search was too shallow to trust
+  if(ENTRY_DEPTH(data) < depth) return false;
+
+  // undo the mate adjustment from when we stored it
+  *score = ENTRY_SCORE(data);
+  if(*score > IS_MATE) *score -= board->ply;
+  else if(*score < -IS_MATE) *score += board->ply;
+
+  switch(ENTRY_FLAGS(data)) {
+    // no move beat alpha back then, so the score is an upper bound
+    case HFALPHA:
+      if(*score <= alpha) {
+        *score = alpha;
+        return true;
+      }
+      break;
+
+    // we got a beta cutoff back then, so the score is a lower bound
+    case HFBETA:
+      if(*score >= beta) {
+        *score = beta;
+        return true;
+      }
+      break;
+
+    // exact score, so just use it
+    case HFEXACT:
+      return true;
+
+    default:
+      ASSERT(false); // bad flag
+  }
 
-  // store the move at that section
-  board->pvt.table[index].move = move;
-  board->pvt.table[index].hashkey = board->hashkey;
+  return false;
 }
 
 /**
- * Essentially the inverse of the above function
- * Returns the move calculated for the given board position
+ * Returns the best move found for the given board position (if any)
+ * Used for move ordering and for pulling out the principal variation
  */
-uint32_t find_move(const Board_t *board) {
+uint32_t probe_pv_move(const Board_t *board) {
   // grab our index and verify it
-  unsigned long index = board->hashkey % (board->pvt.entries);
-  ASSERT(index >= 0 && index < board->pvt.entries);
+  unsigned long index = board->hashkey & (board->hash_table.entries - 1);
+  ASSERT(index >= 0 && index < board->hash_table.entries);
 
-  uint64_t found_hashkey = board->pvt.table[index].hashkey;
+  uint64_t data = board->hash_table.table[index].data;
+  uint64_t found_hashkey = board->hash_table.table[index].smp_key ^ data;
 
   // if the hashkey at the position we found matches our current one, return the move
-  return (found_hashkey == board->hashkey) ? board->pvt.table[index].move : NOMOVE;
+  return (found_hashkey == board->hashkey) ? ENTRY_MOVE(data) : NOMOVE;
 }
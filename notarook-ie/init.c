@@ -109,15 +109,18 @@ static void init_eval_masks(void) {
 
 
 /**
- * Function to generate a random 64 bit unsigned integer
+ * Function to generate a random 64 bit unsigned integer.
+ * This is its own little generator (xorshift64*) with a fixed seed instead of rand(),
+ * so the hash keys come out the same every run (and on every platform). Otherwise
+ * the hashset collides differently every time and no two searches visit the same
+ * nodes, which makes the bench node count (see bench.c) useless
  */
 static uint64_t RAND_64(void) {
-  uint64_t ret = rand();
-  ret |= ((uint64_t)rand() << 15);
-  ret |= ((uint64_t)rand() << 30);
-  ret |= ((uint64_t)rand() << 45);
-  ret |= (((uint64_t)rand() & 0xF) << 60);
-  return ret;
+  static uint64_t state = 0x9E3779B97F4A7C15ULL;
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state * 0x2545F4914F6CDD1DULL;
 }
 
 /**
@@ -214,5 +217,8 @@ void init_all(void) {
   init_hashkeys();
   init_files_ranks_arrays();
   init_eval_masks();
+  init_bitboards();
+  init_psqt();
   init_MVV_LVA();
+  init_reductions();
 }
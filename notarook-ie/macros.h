@@ -22,6 +22,23 @@
 /* sets a bit to 1 */
 #define SETBIT(bb, sq) ((bb) |= SET_MASK[(sq)])
 
+/* sliding piece attacks from a 64 square index given the occupied squares (see bboard.c) */
+#ifdef USE_PEXT
+/* BMI2 cpus can pull the blocker bits straight out into an index, no multiply needed */
+#define MAGIC_INDEX(m, occ) (_pext_u64((occ), (m)->mask))
+#else
+#define MAGIC_INDEX(m, occ) ((((occ) & (m)->mask) * (m)->magic) >> (m)->shift)
+#endif
+#define ROOK_ATTACKS(sq64, occ) (ROOK_MAGICS[(sq64)].attacks[MAGIC_INDEX(&ROOK_MAGICS[(sq64)], (occ))])
+#define BISHOP_ATTACKS(sq64, occ) (BISHOP_MAGICS[(sq64)].attacks[MAGIC_INDEX(&BISHOP_MAGICS[(sq64)], (occ))])
+#define QUEEN_ATTACKS(sq64, occ) (ROOK_ATTACKS((sq64), (occ)) | BISHOP_ATTACKS((sq64), (occ)))
+
+/* for the flags the input thread and the search threads share (see util.c).
+   Stores are release and loads are acquire, so anything written before a flag
+   gets set is there for whoever sees the flag */
+#define ATOMIC_STORE(var, val) (__atomic_store_n(&(var), (val), __ATOMIC_RELEASE))
+#define ATOMIC_LOAD(var) (__atomic_load_n(&(var), __ATOMIC_ACQUIRE))
+
 /* macros to make interacting with the indexed board arrays more straightforward */
 #define SQ64(sq120) (ENGINE_TO_REGULAR[(sq120)])
 #define SQ120(sq64) (REGULAR_TO_ENGINE[(sq64)])
@@ -42,8 +59,19 @@
 #define MOVE(f, t, ca, pro, fl) ((f) | ((t) << 7) | ((ca) << 14) | ((pro) << 20) | (fl))
 #define SQOFFBOARD(sq) (FILES_BOARD[sq] == OFFBOARD)
 
+/* macros for packing/unpacking the data section of a hash entry */
+/* move is 25 bits, score 17 (offset by 0x10000 so it's never negative), depth 8, flags 2, age 8 */
+#define PACK_ENTRY(mv, sc, dp, fl, ag) ((uint64_t)(mv) | ((uint64_t)((sc) + 0x10000) << 25) | \
+  ((uint64_t)(dp) << 42) | ((uint64_t)(fl) << 50) | ((uint64_t)(ag) << 52))
+#define ENTRY_MOVE(d) ((uint32_t)((d) & 0x1FFFFFF))
+#define ENTRY_SCORE(d) ((int32_t)(((d) >> 25) & 0x1FFFF) - 0x10000)
+#define ENTRY_DEPTH(d) ((int32_t)(((d) >> 42) & 0xFF))
+#define ENTRY_FLAGS(d) ((int32_t)(((d) >> 50) & 0x3))
+#define ENTRY_AGE(d) ((uint8_t)(((d) >> 52) & 0xFF))
+
 /* macros for hashing values into the position key */
 #define HASH_PIECE(piece, sq) (board->hashkey ^= (PIECE_KEYS[(piece)][(sq)]))
+#define HASH_PAWN(piece, sq) (board->pawn_key ^= (PIECE_KEYS[(piece)][(sq)]))
 #define HASH_CAS (board->hashkey ^= (CASTLE_KEYS[(board->castle_permission)]))
 #define HASH_SIDE (board->hashkey ^= SIDE_KEY)
 #define HASH_PAS (board->hashkey ^= (PIECE_KEYS[EMPTY][board->passant]))
@@ -44,6 +44,13 @@ static void clear_piece(const int32_t sq, Board_t *board) {
   HASH_PIECE(piece, sq);
   board->pieces[sq] = EMPTY;
   board->material[col] -= PIECE_VAL[piece];
+  board->psqt_mg[col] -= PSQT_MG[piece][SQ64(sq)];
+  board->psqt_eg[col] -= PSQT_EG[piece][SQ64(sq)];
+
+  // take it off of the bitboards
+  CLRBIT(board->piece_bbs[piece], SQ64(sq));
+  CLRBIT(board->color_bbs[col], SQ64(sq));
+  CLRBIT(board->color_bbs[BOTH], SQ64(sq));
 
   // if it's anything other than a pawn, decrease those counts
   if(PIECE_BIG[piece]) {
@@ -57,6 +64,7 @@ static void clear_piece(const int32_t sq, Board_t *board) {
     // if applicable
     CLRBIT(board->pawns[col], SQ64(sq));
     CLRBIT(board->pawns[BOTH], SQ64(sq));
+    HASH_PAWN(piece, sq);
   }
 
   // remove the piece from the piece list of the board
@@ -92,6 +100,11 @@ static void add_piece(const int32_t sq, Board_t *board, const int32_t piece) {
 
   board->pieces[sq] = piece;
 
+  // put it on the bitboards
+  SETBIT(board->piece_bbs[piece], SQ64(sq));
+  SETBIT(board->color_bbs[col], SQ64(sq));
+  SETBIT(board->color_bbs[BOTH], SQ64(sq));
+
   // if it's anything other than a pawn, increase those counts
   if(PIECE_BIG[piece]) {
     board->big_pieces[col]++;
@@ -103,10 +116,13 @@ static void add_piece(const int32_t sq, Board_t *board, const int32_t piece) {
     // pawns are kept on the bitboard as well, so we need to increase those values
     SETBIT(board->pawns[col], SQ64(sq));
     SETBIT(board->pawns[BOTH], SQ64(sq));
+    HASH_PAWN(piece, sq);
   }
 
   // update material value and place the piece on the piece list
   board->material[col] += PIECE_VAL[piece];
+  board->psqt_mg[col] += PSQT_MG[piece][SQ64(sq)];
+  board->psqt_eg[col] += PSQT_EG[piece][SQ64(sq)];
   board->piece_list[piece][board->piece_num[piece]++] = sq;
 }
 
@@ -130,12 +146,23 @@ static void move_piece(const int32_t from, const int32_t to, Board_t *board) {
   HASH_PIECE(piece, to);
   board->pieces[to] = piece;
 
+  // flip both squares on the bitboards in one go
+  uint64_t from_to = SET_MASK[SQ64(from)] | SET_MASK[SQ64(to)];
+  board->piece_bbs[piece] ^= from_to;
+  board->color_bbs[col] ^= from_to;
+  board->color_bbs[BOTH] ^= from_to;
+
+  board->psqt_mg[col] += PSQT_MG[piece][SQ64(to)] - PSQT_MG[piece][SQ64(from)];
+  board->psqt_eg[col] += PSQT_EG[piece][SQ64(to)] - PSQT_EG[piece][SQ64(from)];
+
   // pawns also go on the bitboard
   if(!PIECE_BIG[piece]) {
     CLRBIT(board->pawns[col], SQ64(from));
     CLRBIT(board->pawns[BOTH], SQ64(from));
     SETBIT(board->pawns[col], SQ64(to));
     SETBIT(board->pawns[BOTH], SQ64(to));
+    HASH_PAWN(piece, from);
+    HASH_PAWN(piece, to);
   }
 
   // piece list setting
@@ -293,7 +320,8 @@ void take_move(Board_t *board) {
 /**
  * Time to make a move!
  * Returns false if the side that made the move is in
- * check afterwards
+ * check afterwards. Only the pseudo legal build (USE_PSEUDO_LEGAL) can get
+ * handed moves like that, so everywhere else this is always true
  */
 bool make_move(Board_t *board, uint32_t move) {
 
@@ -412,11 +440,17 @@ bool make_move(Board_t *board, uint32_t move) {
 
   ASSERT(check_board(board));
 
+#ifdef USE_PSEUDO_LEGAL
   // if after we move the king is in check, undo and it's a nope
   if(square_attacked(board->kings_sq[side], board->side, board)) {
     take_move(board);
     return false;
   }
+#else
+  // the move generator only hands out legal moves (see movegen.c), so there's no
+  // need to check, and every move we get passed came from it one way or another
+  ASSERT(!square_attacked(board->kings_sq[side], board->side, board));
+#endif
 
   return true;
 }
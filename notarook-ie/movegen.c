@@ -5,48 +5,16 @@
 #include "functions.h"
 #include "constants.h"
 
-// the 0s give us a way to disambiguate
-// between white and black
-static const int32_t LOOP_SLIDE_PIECE[8] = {
-  wB, wR, wQ, 0, bB, bR, bQ, 0
+// the non pawn pieces for each side, in the order we generate their moves
+// the 0s give us a way to disambiguate between white and black
+static const int32_t LOOP_PIECE[12] = {
+  wN, wB, wR, wQ, wK, 0, bN, bB, bR, bQ, bK, 0
 };
 
-// the 0s give us a way to disambiguate
-// between white and black
-static const int32_t LOOP_NON_SLIDE_PIECE[6] = {
-  wN, wK, 0, bN, bK, 0
-};
-
-// black to move -> 4, white to move -> 0
+// black to move -> 6, white to move -> 0
 // helps us out with the above array to condense the
 // code and not end up with the same mess as the pawns
-static const int32_t LOOP_SLIDE_INDEX[2] = {0, 4};
-
-// same reasoning as above array
-static const int32_t LOOP_NON_SLIDE_INDEX[2] = {0, 3};
-
-// indexing by piece
-static const int32_t NUM_DIR[13] = {
-  0,0,8,4,4,8,8,0,8,4,4,8,8
-};
-
-// the directions on the coordinate system each piece can move
-// maps to the above NUM_DIR
-static const int32_t PIECE_DIR[13][8] = {
-  {0,0,0,0,0,0,0,0},
-  {0,0,0,0,0,0,0,0},
-  {-8,-19,-21,-12,8,19,21,12},
-  {-9,-11,11,9,0,0,0,0},
-  {-1,-10,1,10,0,0,0,0},
-  {-1,-10,1,10,-9,-11,11,9},
-  {-1,-10,1,10,-9,-11,11,9},
-  {0,0,0,0,0,0,0,0},
-  {-8,-19,-21,-12,8,19,21,12},
-  {-9,-11,11,9,0,0,0,0},
-  {-1,-10,1,10,0,0,0,0},
-  {-1,-10,1,10,-9,-11,11,9},
-  {-1,-10,1,10,-9,-11,11,9}
-};
+static const int32_t LOOP_INDEX[2] = {0, 6};
 
 // used in MVV-LVA eval; maps to the pieces enum (hence the 0)
 // kings can't be captured, so the 600 spots are basically useless
@@ -100,10 +68,18 @@ static void add_capture_move(const Board_t * board, uint32_t move, MoveList_t *l
   ASSERT(square_on_board(TOSQ(move)));
   ASSERT(piece_valid(CAPTURED(move)));
 
+  int32_t attacker = board->pieces[FROMSQ(move)];
   list->moves[list->count].move = move;
+  list->moves[list->count].score = MVV_LVA_SCORES[CAPTURED(move)][attacker];
+
   // the plus 1M is for the history and killer moves heuristics
-  // this ensures that captures are searched first
-  list->moves[list->count].score = MVV_LVA_SCORES[CAPTURED(move)][board->pieces[FROMSQ(move)]] + 1000000;
+  // this ensures that captures are searched first.
+  // captures that just lose material (the piece gets taken back for more than
+  // it won) don't get it, so they go after the killers. Taking something worth
+  // at least as much as the attacker can never lose, so only check the rest
+  if(PIECE_VAL[attacker] <= PIECE_VAL[CAPTURED(move)] || static_exchange(board, move) >= 0) {
+    list->moves[list->count].score += 1000000;
+  }
   list->count++;
 }
 
@@ -220,187 +196,78 @@ bool move_exists(Board_t *board, const uint32_t move) {
 }
 
 /**
- * Generate all capture moves, but no quiet moves.
- * Basically the same code as the generate_all_moves, just minus the quiet moves
+ * Looks up every square a non pawn piece on the given (64 square) square attacks
  */
-void generate_all_captures(const Board_t *board, MoveList_t *list) {
-
-  ASSERT(check_board(board));
-
-  list->count = 0;
+static uint64_t piece_attacks(const int32_t piece, const int32_t sq64, const uint64_t occupied) {
+  if(IsKn(piece)) return KNIGHT_ATTACKS[sq64];
+  if(IsKi(piece)) return KING_ATTACKS[sq64];
+  if(IsRQ(piece) && IsBQ(piece)) return QUEEN_ATTACKS(sq64, occupied);
+  if(IsRQ(piece)) return ROOK_ATTACKS(sq64, occupied);
+  return BISHOP_ATTACKS(sq64, occupied);
+}
 
-  int32_t piece = EMPTY;
+/**
+ * Adds every pawn capture (en passant included) for the side to move
+ */
+static void generate_pawn_captures(const Board_t *board, MoveList_t *list) {
   int32_t side = board->side;
-  int32_t sq = 0, temp_sq = 0;
-  int32_t piece_num = 0;
-  int32_t index = 0;
-  int32_t dir;
-
-  if(side == WHITE) {
-    for(piece_num = 0; piece_num < board->piece_num[wP]; ++piece_num) {
-      sq = board->piece_list[wP][piece_num];
-
-      ASSERT(square_on_board(sq));
-
-      // checking for white's pawn captures
-      if(!SQOFFBOARD(sq + 9) && PIECE_COL[board->pieces[sq + 9]] == BLACK) {
-        add_white_pawn_capture(board, sq, sq + 9, board->pieces[sq + 9], list);
-      }
-      if(!SQOFFBOARD(sq + 11) && PIECE_COL[board->pieces[sq + 11]] == BLACK) {
-        add_white_pawn_capture(board, sq, sq + 11, board->pieces[sq + 11], list);
-      }
-
-      // check on croissant move
-      if(board->passant != NO_SQ) {
-        if(sq + 9 == board->passant) {
-          add_enpassant_move(MOVE(sq, sq + 9, EMPTY, EMPTY, MFLAGEP), list);
-        }
-        if(sq + 11 == board->passant) {
-          add_enpassant_move(MOVE(sq, sq + 11, EMPTY, EMPTY, MFLAGEP), list);
-        }
-      }
-    }
+  uint64_t pawns = board->piece_bbs[(side == WHITE) ? wP : bP];
+  uint64_t enemies = board->color_bbs[side ^ 1];
+  uint64_t passant = (board->passant != NO_SQ) ? SET_MASK[SQ64(board->passant)] : (uint64_t)0;
 
-  } else {
-    for(piece_num = 0; piece_num < board->piece_num[bP]; ++piece_num) {
-      sq = board->piece_list[bP][piece_num];
+  while(pawns) {
+    int32_t sq64 = pop_bit(&pawns);
+    int32_t sq = SQ120(sq64);
+    uint64_t captures = PAWN_ATTACKS[side][sq64] & enemies;
 
-      ASSERT(square_on_board(sq));
-
-      // checking for blacks's pawn captures
-      if(!SQOFFBOARD(sq - 9) && PIECE_COL[board->pieces[sq - 9]] == WHITE) {
-        add_black_pawn_capture(board, sq, sq - 9, board->pieces[sq - 9], list);
-      }
-      if(!SQOFFBOARD(sq - 11) && PIECE_COL[board->pieces[sq - 11]] == WHITE) {
-        add_black_pawn_capture(board, sq, sq - 11, board->pieces[sq - 11], list);
-      }
+    ASSERT(square_on_board(sq));
 
-      // check on croissant move
-      if(board->passant != NO_SQ) {
-        if(sq - 9 == board->passant) {
-          add_enpassant_move(MOVE(sq, sq - 9, EMPTY, EMPTY, MFLAGEP), list);
-        }
-        if(sq - 11 == board->passant) {
-          add_enpassant_move(MOVE(sq, sq - 11, EMPTY, EMPTY, MFLAGEP), list);
-        }
-      }
+    while(captures) {
+      int32_t to = SQ120(pop_bit(&captures));
+      if(side == WHITE) add_white_pawn_capture(board, sq, to, board->pieces[to], list);
+      else add_black_pawn_capture(board, sq, to, board->pieces[to], list);
     }
-  }
-
-  // sllllllliiiide to the left (and right, front, back, and diagonally)
-  int32_t piece_index = LOOP_SLIDE_INDEX[side];
-  piece = LOOP_SLIDE_PIECE[piece_index++];
-
-  while(piece) {
-    ASSERT(piece_valid(piece));
-
-    for(piece_num = 0; piece_num < board->piece_num[piece]; ++piece_num) {
-      sq = board->piece_list[piece][piece_num];
-
-      ASSERT(square_on_board(sq));
 
-      for(index = 0; index < NUM_DIR[piece]; ++index) {
-        dir = PIECE_DIR[piece][index];
-        temp_sq = sq + dir;
-
-        while(!SQOFFBOARD(temp_sq)) {
-          if(board->pieces[temp_sq] != EMPTY) {
-            if(PIECE_COL[board->pieces[temp_sq]] == (side ^ 1)) {
-              add_capture_move(board, MOVE(sq, temp_sq, board->pieces[temp_sq], EMPTY, 0), list);
-            }
-            break;
-          }
-          temp_sq += dir; // increment the temp square by the direction to go to the next
-                          // square
-        }
-      }
+    // check on croissant move
+    if(PAWN_ATTACKS[side][sq64] & passant) {
+      add_enpassant_move(MOVE(sq, board->passant, EMPTY, EMPTY, MFLAGEP), list);
     }
-
-    piece = LOOP_SLIDE_PIECE[piece_index++];
-  }
-
-  // non sliding pieces
-  piece_index = LOOP_NON_SLIDE_INDEX[side];
-  piece = LOOP_NON_SLIDE_PIECE[piece_index++];
-  while(piece) {
-    ASSERT(piece_valid(piece));
-
-    for(piece_num = 0; piece_num < board->piece_num[piece]; ++piece_num) {
-      sq = board->piece_list[piece][piece_num];
-      ASSERT(square_on_board(sq));
-
-      for(index = 0; index < NUM_DIR[piece]; ++index) {
-        dir = PIECE_DIR[piece][index];
-        temp_sq = sq + dir;
-
-        if(!SQOFFBOARD(temp_sq)) {
-
-          // captures
-          // little bit of bit magic where WHITE ^ 1 == BLACK and vice versa
-          if(board->pieces[temp_sq] != EMPTY) {
-            if(PIECE_COL[board->pieces[temp_sq]] == (side ^ 1)) {
-              add_capture_move(board, MOVE(sq, temp_sq, board->pieces[temp_sq], EMPTY, 0), list);
-            }
-            continue;
-          }
-        } else {
-          continue;
-        }
-      }
-    }
-    piece = LOOP_NON_SLIDE_PIECE[piece_index++];
   }
 }
 
 /**
- * Generate all moves for a given board position
+ * Adds every pawn push (one square, two squares, and promotions) for the side to move
  */
-void generate_all_moves(const Board_t *board, MoveList_t *list) {
-
-  ASSERT(check_board(board));
-
-  list->count = 0;
-
-  int32_t piece = EMPTY;
+static void generate_pawn_pushes(const Board_t *board, MoveList_t *list) {
   int32_t side = board->side;
-  int32_t sq = 0, temp_sq = 0;
-  int32_t piece_num = 0;
-  int32_t index = 0;
-  int32_t dir;
+  uint64_t pawns = board->piece_bbs[(side == WHITE) ? wP : bP];
 
-  if(side == WHITE) {
-    for(piece_num = 0; piece_num < board->piece_num[wP]; ++piece_num) {
-      sq = board->piece_list[wP][piece_num];
+  // in our representation, forward for white is + 10 coordinate points
+  // and forward for black is - 10 coordinate points
+  int32_t forward = (side == WHITE) ? 10 : -10;
+  int32_t start_rank = (side == WHITE) ? RANK_2 : RANK_7;
 
-      ASSERT(square_on_board(sq));
+  while(pawns) {
+    int32_t sq = SQ120(pop_bit(&pawns));
 
-      // in our representation, forward for white is + 10 coordinate points
-      if(board->pieces[sq + 10] == EMPTY) {
-        add_white_pawn_move(board, sq, sq + 10, list);
-        if(RANKS_BOARD[sq] == RANK_2 && board->pieces[sq + 20] == EMPTY) {
-          add_quiet_move(board, MOVE(sq, sq + 20, EMPTY, EMPTY, MFLAGPS), list);
-        }
-      }
+    ASSERT(square_on_board(sq));
 
-      // checking for white's pawn captures
-      if(!SQOFFBOARD(sq + 9) && PIECE_COL[board->pieces[sq + 9]] == BLACK) {
-        add_white_pawn_capture(board, sq, sq + 9, board->pieces[sq + 9], list);
-      }
-      if(!SQOFFBOARD(sq + 11) && PIECE_COL[board->pieces[sq + 11]] == BLACK) {
-        add_white_pawn_capture(board, sq, sq + 11, board->pieces[sq + 11], list);
-      }
+    if(board->pieces[sq + forward] == EMPTY) {
+      if(side == WHITE) add_white_pawn_move(board, sq, sq + forward, list);
+      else add_black_pawn_move(board, sq, sq + forward, list);
 
-      // check on croissant move
-      if(board->passant != NO_SQ) {
-        if(sq + 9 == board->passant) {
-          add_enpassant_move(MOVE(sq, sq + 9, EMPTY, EMPTY, MFLAGEP), list);
-        }
-        if(sq + 11 == board->passant) {
-          add_enpassant_move(MOVE(sq, sq + 11, EMPTY, EMPTY, MFLAGEP), list);
-        }
+      if(RANKS_BOARD[sq] == start_rank && board->pieces[sq + 2 * forward] == EMPTY) {
+        add_quiet_move(board, MOVE(sq, sq + 2 * forward, EMPTY, EMPTY, MFLAGPS), list);
       }
     }
+  }
+}
 
+/**
+ * Adds the castling moves for the side to move
+ */
+static void generate_castles(const Board_t *board, MoveList_t *list) {
+  if(board->side == WHITE) {
     // castling, first kingside
     // if we can castle, the squares are empty, and the squares aren't attacked, we may
     // be able to castle. We don't check for if the king is moving through check here
@@ -422,42 +289,7 @@ void generate_all_moves(const Board_t *board, MoveList_t *list) {
       }
     }
   } else {
-    for(piece_num = 0; piece_num < board->piece_num[bP]; ++piece_num) {
-      sq = board->piece_list[bP][piece_num];
-
-      ASSERT(square_on_board(sq));
-
-      // in our representation, forward for black is - 10 coordinate points
-      if(board->pieces[sq - 10] == EMPTY) {
-        add_black_pawn_move(board, sq, sq - 10, list);
-        if(RANKS_BOARD[sq] == RANK_7 && board->pieces[sq - 20] == EMPTY) {
-          add_quiet_move(board, MOVE(sq, sq - 20, EMPTY, EMPTY, MFLAGPS), list);
-        }
-      }
-
-      // checking for blacks's pawn captures
-      if(!SQOFFBOARD(sq - 9) && PIECE_COL[board->pieces[sq - 9]] == WHITE) {
-        add_black_pawn_capture(board, sq, sq - 9, board->pieces[sq - 9], list);
-      }
-      if(!SQOFFBOARD(sq - 11) && PIECE_COL[board->pieces[sq - 11]] == WHITE) {
-        add_black_pawn_capture(board, sq, sq - 11, board->pieces[sq - 11], list);
-      }
-
-      // check on croissant move
-      if(board->passant != NO_SQ) {
-        if(sq - 9 == board->passant) {
-          add_enpassant_move(MOVE(sq, sq - 9, EMPTY, EMPTY, MFLAGEP), list);
-        }
-        if(sq - 11 == board->passant) {
-          add_enpassant_move(MOVE(sq, sq - 11, EMPTY, EMPTY, MFLAGEP), list);
-        }
-      }
-    }
-
-    // castling, first kingside
-    // if we can castle, the squares are empty, and the squares aren't attacked, we may
-    // be able to castle. We don't check for if the king is moving through check here
-    // since we do that later in the function
+    // same as white, but on the other side of the board
     if(board->castle_permission & BKCAS) {
       if(board->pieces[F8] == EMPTY && board->pieces[G8] == EMPTY) {
         if(!square_attacked(E8, WHITE, board) && !square_attacked(F8, WHITE, board)) {
@@ -466,7 +298,6 @@ void generate_all_moves(const Board_t *board, MoveList_t *list) {
       }
     }
 
-    // logic here is very much the same as kingside above
     if(board->castle_permission & BQCAS) {
       if(board->pieces[D8] == EMPTY && board->pieces[C8] == EMPTY && board->pieces[B8] == EMPTY) {
         if(!square_attacked(E8, WHITE, board) && !square_attacked(D8, WHITE, board)) {
@@ -475,70 +306,451 @@ void generate_all_moves(const Board_t *board, MoveList_t *list) {
       }
     }
   }
+}
 
-  // sllllllliiiide to the left (and right, front, back, and diagonally)
-  int32_t piece_index = LOOP_SLIDE_INDEX[side];
-  piece = LOOP_SLIDE_PIECE[piece_index++];
+/**
+ * Adds the moves of every non pawn piece for the side to move.
+ * Captures and quiet moves each only get added if asked for
+ */
+static void generate_piece_moves(const Board_t *board, MoveList_t *list, const bool captures, const bool quiets) {
+  int32_t side = board->side;
+  uint64_t occupied = board->color_bbs[BOTH];
+  uint64_t enemies = board->color_bbs[side ^ 1];
+
+  int32_t piece_index = LOOP_INDEX[side];
+  int32_t piece = LOOP_PIECE[piece_index++];
 
   while(piece) {
     ASSERT(piece_valid(piece));
 
-    for(piece_num = 0; piece_num < board->piece_num[piece]; ++piece_num) {
-      sq = board->piece_list[piece][piece_num];
+    uint64_t pieces = board->piece_bbs[piece];
+
+    while(pieces) {
+      int32_t sq64 = pop_bit(&pieces);
+      int32_t sq = SQ120(sq64);
+      uint64_t attacks = piece_attacks(piece, sq64, occupied);
 
       ASSERT(square_on_board(sq));
 
-      for(index = 0; index < NUM_DIR[piece]; ++index) {
-        dir = PIECE_DIR[piece][index];
-        temp_sq = sq + dir;
-
-        while(!SQOFFBOARD(temp_sq)) {
-          if(board->pieces[temp_sq] != EMPTY) {
-            if(PIECE_COL[board->pieces[temp_sq]] == (side ^ 1)) {
-              add_capture_move(board, MOVE(sq, temp_sq, board->pieces[temp_sq], EMPTY, 0), list);
-            }
-            break;
-          }
-          add_quiet_move(board, MOVE(sq, temp_sq, EMPTY, EMPTY, 0), list);
-          temp_sq += dir; // increment the temp square by the direction to go to the next
-                          // square
+      // captures are the attacked squares with an enemy on them
+      uint64_t targets = (captures) ? attacks & enemies : 0;
+      while(targets) {
+        int32_t to = SQ120(pop_bit(&targets));
+        add_capture_move(board, MOVE(sq, to, board->pieces[to], EMPTY, 0), list);
+      }
+
+      // quiet moves are the attacked squares with nothing on them
+      if(quiets) {
+        targets = attacks & ~occupied;
+        while(targets) {
+          add_quiet_move(board, MOVE(sq, SQ120(pop_bit(&targets)), EMPTY, EMPTY, 0), list);
         }
       }
     }
 
-    piece = LOOP_SLIDE_PIECE[piece_index++];
+    piece = LOOP_PIECE[piece_index++];
   }
+}
 
-  // non sliding pieces
-  piece_index = LOOP_NON_SLIDE_INDEX[side];
-  piece = LOOP_NON_SLIDE_PIECE[piece_index++];
-  while(piece) {
-    ASSERT(piece_valid(piece));
+/**
+ * Works out what a move has to do to not leave our king in check, all in one go:
+ * which of our pieces are pinned to the king (they can only slide along the pin), and
+ * which squares a move that isn't the king's has to land on. That's anywhere when
+ * we aren't in check, the checker or a square in between when checked once, and
+ * nowhere when checked twice (only the king can do something about a double check)
+ */
+void legal_masks(const Board_t *board, uint64_t *pinned, uint64_t *targets) {
+  int32_t side = board->side;
+  int32_t king = SQ64(board->kings_sq[side]);
+  uint64_t occupied = board->color_bbs[BOTH];
+  uint64_t enemies = board->color_bbs[side ^ 1];
+  uint64_t checkers = attackers_to(board, king, occupied) & enemies;
+
+  // enemy sliders that would see our king on an empty board. If exactly one
+  // piece is in the way and it's ours, it's pinned
+  int32_t offset = (side == WHITE) ? (bP - wP) : 0;
+  uint64_t snipers = (ROOK_ATTACKS(king, 0) & (board->piece_bbs[wR + offset] | board->piece_bbs[wQ + offset]))
+                   | (BISHOP_ATTACKS(king, 0) & (board->piece_bbs[wB + offset] | board->piece_bbs[wQ + offset]));
+
+  *pinned = 0;
+  while(snipers) {
+    uint64_t blockers = BETWEEN_BB[king][pop_bit(&snipers)] & occupied;
+    if(blockers && !(blockers & (blockers - 1))) *pinned |= blockers & board->color_bbs[side];
+  }
 
-    for(piece_num = 0; piece_num < board->piece_num[piece]; ++piece_num) {
-      sq = board->piece_list[piece][piece_num];
-      ASSERT(square_on_board(sq));
+  if(!checkers) {
+    *targets = ~(uint64_t)0;
+  } else if(checkers & (checkers - 1)) {
+    *targets = 0;
+  } else {
+    uint64_t checker = checkers;
+    *targets = checkers | BETWEEN_BB[king][pop_bit(&checker)];
+  }
+}
 
-      for(index = 0; index < NUM_DIR[piece]; ++index) {
-        dir = PIECE_DIR[piece][index];
-        temp_sq = sq + dir;
-
-        if(!SQOFFBOARD(temp_sq)) {
-
-          // captures
-          // little bit of bit magic where WHITE ^ 1 == BLACK and vice versa
-          if(board->pieces[temp_sq] != EMPTY) {
-            if(PIECE_COL[board->pieces[temp_sq]] == (side ^ 1)) {
-              add_capture_move(board, MOVE(sq, temp_sq, board->pieces[temp_sq], EMPTY, 0), list);
-            }
-            continue;
-          }
-          add_quiet_move(board, MOVE(sq, temp_sq, EMPTY, EMPTY, 0), list);
-        } else {
-          continue;
-        }
-      }
+// the pseudo legal build leaves the legality checking to make_move
+#ifndef USE_PSEUDO_LEGAL
+
+/**
+ * Checks if a pseudo legal move keeps our king out of check, using the masks from above
+ */
+static bool move_legal(const Board_t *board, const uint32_t move, const uint64_t pinned, const uint64_t targets) {
+  int32_t side = board->side;
+  int32_t king = SQ64(board->kings_sq[side]);
+  int32_t from = SQ64(FROMSQ(move)), to = SQ64(TOSQ(move));
+  uint64_t occupied = board->color_bbs[BOTH];
+  uint64_t enemies = board->color_bbs[side ^ 1];
+
+  // the king can't walk into an attack. It comes off the board for this so that
+  // a slider checking it along a line still covers the square behind it.
+  // (castling makes it here too, the squares it passes through get checked in generate_castles)
+  if(from == king) return !(attackers_to(board, to, occupied ^ SET_MASK[king]) & enemies);
+
+  // en passant takes two pawns off of the same rank at once, which can uncover an
+  // attack on the king no pin would have caught, so just look at the board afterwards
+  if(move & MFLAGEP) {
+    int32_t captured = (side == WHITE) ? to - 8 : to + 8;
+    occupied ^= SET_MASK[from] | SET_MASK[to] | SET_MASK[captured];
+    return !(attackers_to(board, king, occupied) & enemies & ~SET_MASK[captured]);
+  }
+
+  if(!(targets & SET_MASK[to])) return false;
+
+  // pinned pieces can still move along the line of the pin
+  return !(pinned & SET_MASK[from]) || (LINE_BB[king][from] & SET_MASK[to]);
+}
+
+#endif
+
+/**
+ * Throws out the moves from start onwards that would leave our own king in check.
+ * The pins and checks get worked out once up front, so each move is just a couple
+ * of mask checks (only king moves and en passant need to look at attacks)
+ */
+static void keep_legal_moves(const Board_t *board, MoveList_t *list, const int32_t start) {
+
+#ifdef USE_PSEUDO_LEGAL
+  // make_move does the checking in this build
+  (void)board; (void)list; (void)start;
+#else
+  uint64_t pinned, targets;
+  legal_masks(board, &pinned, &targets);
+
+  int32_t kept = start;
+  for(int32_t idx = start; idx < list->count; ++idx) {
+    if(move_legal(board, list->moves[idx].move, pinned, targets)) list->moves[kept++] = list->moves[idx];
+  }
+  list->count = kept;
+#endif
+}
+
+/**
+ * Generate all capture moves, but no quiet moves.
+ */
+void generate_all_captures(const Board_t *board, MoveList_t *list) {
+
+  ASSERT(check_board(board));
+
+  list->count = 0;
+
+  generate_pawn_captures(board, list);
+  generate_piece_moves(board, list, true, false);
+
+  keep_legal_moves(board, list, 0);
+}
+
+/**
+ * Generate all moves for a given board position.
+ * These are all legal, unless this is the pseudo legal build (USE_PSEUDO_LEGAL), which
+ * leaves it up to make_move to turn down the moves that leave the king in check
+ */
+void generate_all_moves(const Board_t *board, MoveList_t *list) {
+
+  ASSERT(check_board(board));
+
+  list->count = 0;
+
+  generate_pawn_pushes(board, list);
+  generate_pawn_captures(board, list);
+  generate_castles(board, list);
+  generate_piece_moves(board, list, true, true);
+
+  keep_legal_moves(board, list, 0);
+}
+
+/**
+ * Adds every quiet move to the end of the list (without clearing it first).
+ * Used by the move picker so the captures it already has stay put.
+ * Pawn pushes go last so that when the history scores don't know any better,
+ * piece moves get looked at before pawn moves we can't take back
+ */
+static void generate_all_quiets(const Board_t *board, MoveList_t *list) {
+
+  ASSERT(check_board(board));
+
+  int32_t start = list->count;
+
+  generate_castles(board, list);
+  generate_piece_moves(board, list, false, true);
+  generate_pawn_pushes(board, list);
+
+  keep_legal_moves(board, list, start);
+}
+
+/**
+ * Checks if a move that didn't come from generating moves for this position
+ * (hash move, killers) could actually be played here, legality aside.
+ * Playing a move that doesn't fit the board would wreck it, so the move
+ * picker checks these before handing them out
+ */
+static bool move_pseudo_legal(const Board_t *board, const uint32_t move) {
+
+  if(move == NOMOVE) return false;
+
+  int32_t from = FROMSQ(move), to = TOSQ(move);
+  if(from >= BOARD_SQ_NUM || to >= BOARD_SQ_NUM) return false;
+  if(!square_on_board(from) || !square_on_board(to)) return false;
+
+  int32_t side = board->side;
+  int32_t piece = board->pieces[from];
+  int32_t captured = CAPTURED(move);
+  int32_t promoted = PROMOTED(move);
+
+  // has to be our piece moving
+  if(piece == EMPTY || PIECE_COL[piece] != side) return false;
+
+  // whatever the move says it captures has to actually be sitting there
+  // (en passant is the odd one out, the target square is empty for that)
+  if(captured != board->pieces[to] && !(move & MFLAGEP)) return false;
+  if(captured != EMPTY && PIECE_COL[captured] != (side ^ 1)) return false;
+
+  // castling has a bunch of conditions, so just see if the generator comes up with it
+  if(move & MFLAGCAS) {
+    if(!PIECE_KING[piece]) return false;
+    MoveList_t castles;
+    castles.count = 0;
+    generate_castles(board, &castles);
+    for(int32_t idx = 0; idx < castles.count; ++idx) {
+      if(castles.moves[idx].move == move) return true;
+    }
+    return false;
+  }
+
+  if(PIECE_PAWN[piece]) {
+    int32_t forward = (side == WHITE) ? 10 : -10;
+    int32_t last_rank = (side == WHITE) ? RANK_8 : RANK_1;
+
+    // pawns promote if and only if they reach the last rank
+    if((RANKS_BOARD[to] == last_rank) != (promoted != EMPTY)) return false;
+    if(promoted != EMPTY && (PIECE_COL[promoted] != side || PIECE_PAWN[promoted] || PIECE_KING[promoted])) return false;
+
+    if(move & MFLAGEP) {
+      return to == board->passant && (PAWN_ATTACKS[side][SQ64(from)] & SET_MASK[SQ64(to)]);
+    }
+
+    if(captured != EMPTY) return PAWN_ATTACKS[side][SQ64(from)] & SET_MASK[SQ64(to)];
+
+    if(move & MFLAGPS) {
+      return RANKS_BOARD[from] == ((side == WHITE) ? RANK_2 : RANK_7)
+          && to == from + 2 * forward && board->pieces[from + forward] == EMPTY;
     }
-    piece = LOOP_NON_SLIDE_PIECE[piece_index++];
+
+    return to == from + forward;
+  }
+
+  if(move & (MFLAGEP | MFLAGPS | MFLAGPR)) return false;
+
+  return piece_attacks(piece, SQ64(from), board->color_bbs[BOTH]) & SET_MASK[SQ64(to)];
+}
+
+/**
+ * Checks a move that didn't come from generating moves for this position all the way:
+ * it has to fit the board, and (unless make_move is the one checking, see
+ * generate_all_moves) it can't leave our king in check either
+ */
+static bool move_playable(const Board_t *board, const uint32_t move) {
+  if(!move_pseudo_legal(board, move)) return false;
+
+#ifdef USE_PSEUDO_LEGAL
+  return true;
+#else
+  uint64_t pinned, targets;
+  legal_masks(board, &pinned, &targets);
+  return move_legal(board, move, pinned, targets);
+#endif
+}
+
+/**
+ * Builds the move from one square to another (promoting to promoted, for promotions)
+ * straight from the board. The flags come from what's moving where. It isn't checked
+ * at all yet, NOMOVE only means there's nothing on the from square
+ */
+static uint32_t build_move(const Board_t *board, const int32_t from, const int32_t to, int32_t promoted) {
+  ASSERT(square_on_board(from) && square_on_board(to));
+
+  int32_t piece = board->pieces[from];
+  int32_t flags = 0;
+  if(piece == EMPTY) return NOMOVE;
+
+  if(PIECE_PAWN[piece]) {
+    if(to == board->passant) flags = MFLAGEP;
+    else if(abs(to - from) == 20) flags = MFLAGPS;
+  } else if(PIECE_KING[piece] && abs(to - from) == 2) {
+    flags = MFLAGCAS;
+  }
+
+  // a promotion piece only means something for a pawn reaching the last rank
+  if(!PIECE_PAWN[piece] || (RANKS_BOARD[to] != RANK_8 && RANKS_BOARD[to] != RANK_1)) promoted = EMPTY;
+
+  return MOVE(from, to, board->pieces[to], promoted, flags);
+}
+
+/**
+ * Finds the move from one square to another (promoting to promoted, for promotions)
+ * by building it instead of generating every move and looking for it, then checks it
+ * the same way the hash move does. Returns NOMOVE if there's no such move here
+ */
+uint32_t find_move(const Board_t *board, const int32_t from, const int32_t to, const int32_t promoted) {
+  uint32_t move = build_move(board, from, to, promoted);
+  return (move != NOMOVE && move_playable(board, move)) ? move : NOMOVE;
+}
+
+/**
+ * Same as find_move, but with the pins and checks from legal_masks already worked out.
+ * For looking up a bunch of moves in the same position (like all the book moves)
+ * without redoing the masks for each one
+ */
+uint32_t find_move_masked(const Board_t *board, const int32_t from, const int32_t to, const int32_t promoted,
+                          const uint64_t pinned, const uint64_t targets) {
+  uint32_t move = build_move(board, from, to, promoted);
+  if(move == NOMOVE || !move_pseudo_legal(board, move)) return NOMOVE;
+
+#ifdef USE_PSEUDO_LEGAL
+  (void)pinned; (void)targets;
+  return move;
+#else
+  return move_legal(board, move, pinned, targets) ? move : NOMOVE;
+#endif
+}
+
+/**
+ * Moves the best scoring move between start and end to start.
+ * Only does as much sorting as we need, since most of the time a cutoff
+ * means we never look at the rest of the moves anyways
+ */
+static void pick_best_move(MoveList_t *list, const int32_t start, const int32_t end) {
+  int32_t best = start;
+
+  for(int32_t idx = start + 1; idx < end; ++idx) {
+    if(list->moves[idx].score > list->moves[best].score) best = idx;
+  }
+
+  Move_t temp = list->moves[start];
+  list->moves[start] = list->moves[best];
+  list->moves[best] = temp;
+}
+
+/**
+ * Gets the move picker ready for a new position. Nothing gets generated
+ * until next_move asks for it. Passing false for quiets only hands out the
+ * captures that don't lose material (for quiescence)
+ */
+void init_move_picker(const Board_t *board, MovePicker_t *picker, const uint32_t tt_move, const bool quiets) {
+  picker->stage = (quiets) ? PICK_TT : PICK_GEN_CAPTURES;
+  picker->index = 0;
+  picker->captures_end = 0;
+  picker->bad_captures = 0;
+  picker->tt_move = (quiets) ? tt_move : NOMOVE;
+  picker->killers[0] = board->search_killers[0][board->ply];
+  picker->killers[1] = board->search_killers[1][board->ply];
+  picker->quiets = quiets;
+  picker->list.count = 0;
+}
+
+/**
+ * Hands out the next move to search, or NOMOVE once we're out. In order:
+ * the hash move, captures that don't lose material (best MVV-LVA first), the
+ * killers, the rest of the quiet moves by history, and finally the losing captures.
+ * Each stage only gets generated once we get to it, so a hash move cutoff
+ * doesn't generate anything at all.
+ * Moves are legal, or pseudo legal in the USE_PSEUDO_LEGAL build (see generate_all_moves)
+ */
+uint32_t next_move(const Board_t *board, MovePicker_t *picker) {
+  MoveList_t *list = &picker->list;
+  uint32_t move;
+
+  switch(picker->stage) {
+    case PICK_TT:
+      picker->stage = PICK_GEN_CAPTURES;
+      if(move_playable(board, picker->tt_move)) return picker->tt_move;
+      /* fall through */
+
+    case PICK_GEN_CAPTURES:
+      generate_all_captures(board, list);
+      picker->captures_end = list->count;
+      picker->index = 0;
+      picker->stage = PICK_CAPTURES;
+      /* fall through */
+
+    case PICK_CAPTURES:
+      while(picker->index < picker->captures_end) {
+        pick_best_move(list, picker->index, picker->captures_end);
+
+        // the losing captures don't have the 1M bonus (see add_capture_move), and since
+        // we go best first everything after this one is losing too. Save them for last
+        if(list->moves[picker->index].score < 1000000) break;
+
+        move = list->moves[picker->index++].move;
+        if(move != picker->tt_move) return move;
+      }
+      picker->bad_captures = picker->index;
+
+      if(!picker->quiets) {
+        picker->stage = PICK_DONE;
+        return NOMOVE;
+      }
+      picker->stage = PICK_KILLER_1;
+      /* fall through */
+
+    case PICK_KILLER_1:
+      picker->stage = PICK_KILLER_2;
+      move = picker->killers[0];
+      if(move != picker->tt_move && move_playable(board, move)) return move;
+      /* fall through */
+
+    case PICK_KILLER_2:
+      picker->stage = PICK_GEN_QUIETS;
+      move = picker->killers[1];
+      if(move != picker->tt_move && move != picker->killers[0] && move_playable(board, move)) return move;
+      /* fall through */
+
+    case PICK_GEN_QUIETS:
+      list->count = picker->captures_end;
+      generate_all_quiets(board, list);
+      picker->index = picker->captures_end;
+      picker->stage = PICK_QUIETS;
+      /* fall through */
+
+    case PICK_QUIETS:
+      while(picker->index < list->count) {
+        pick_best_move(list, picker->index, list->count);
+        move = list->moves[picker->index++].move;
+        if(move != picker->tt_move && move != picker->killers[0] && move != picker->killers[1]) return move;
+      }
+      picker->index = picker->bad_captures;
+      picker->stage = PICK_BAD_CAPTURES;
+      /* fall through */
+
+    case PICK_BAD_CAPTURES:
+      while(picker->index < picker->captures_end) {
+        pick_best_move(list, picker->index, picker->captures_end);
+        move = list->moves[picker->index++].move;
+        if(move != picker->tt_move) return move;
+      }
+      picker->stage = PICK_DONE;
+      /* fall through */
+
+    default:
+      return NOMOVE;
   }
 }
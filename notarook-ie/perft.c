@@ -9,12 +9,69 @@
 #include "functions.h"
 #include "constants.h"
 
+// everything the perft threads share. Root moves are handed out one at a time
+// so a thread that gets a small subtree just goes back for another one.
+// (no pthreads on windows, see constants.h, so the calling thread does all of it there)
+typedef struct PerftJob {
+  const Board_t *board; // root position, each thread searches its own copy
+  MoveList_t list; // moves from the root position
+  uint64_t leaves[MAX_POSITION_MOVES]; // leaf count under each root move
+  bool legal[MAX_POSITION_MOVES]; // which root moves were actually legal
+  int32_t next; // index of the next root move nobody has taken yet
+  int32_t depth;
+  HashTable_t *ht; // shared perft hash (can be NULL)
+#ifndef WIN32
+  pthread_mutex_t lock; // guards next
+#endif
+} PerftJob_t;
+
+typedef struct PerftThread {
+  Board_t board;
+  PerftJob_t *job;
+#ifndef WIN32
+  pthread_t handle;
+#endif
+} PerftThread_t;
+
+/**
+ * Looks up the leaf count for a position at a given depth in the perft hash.
+ * The entries use the same lockless xor trick as the transposition table
+ * (see hashset.c), so an entry that got half written by another thread just looks
+ * like a miss. The data is the count shifted up 8 bits with the depth in the bottom 8
+ */
+static bool probe_perft_hash(const HashTable_t *ht, const uint64_t key, const int32_t depth, uint64_t *count) {
+  const HashEntry_t *entry = &ht->table[key & (ht->entries - 1)];
+  uint64_t data = entry->data;
+
+  if((entry->smp_key ^ data) != key || (int32_t)(data & 0xFF) != depth) return false;
+
+  *count = data >> 8;
+  return true;
+}
+
+/**
+ * Stores the leaf count for a position at a given depth in the perft hash,
+ * always replacing whatever was there
+ */
+static void store_perft_hash(HashTable_t *ht, const uint64_t key, const int32_t depth, const uint64_t count) {
+  HashEntry_t *entry = &ht->table[key & (ht->entries - 1)];
+  uint64_t data = (count << 8) | (uint64_t)depth;
+
+  entry->data = data;
+  entry->smp_key = key ^ data;
+}
+
 /**
  * Run a perft test for a given depth. Recursive to traverse every
  * branch of the possible move tree. Updates count as an output param
- * for the number of leaf nodes in our move tree
+ * for the number of leaf nodes in our move tree.
+ * Subtrees of depth 2 or more get cached in the perft hash (if there is one)
+ * since the same positions show up over and over through transpositions.
+ * One ply from the bottom we don't bother playing the moves out, since every
+ * generated move is legal the count is just the length of the move list
+ * (the pseudo legal build still has to play them, see movegen.c)
  */
-static void perft(int32_t depth, Board_t *board, uint64_t *count) {
+static void perft(int32_t depth, Board_t *board, uint64_t *count, HashTable_t *ht) {
 
   ASSERT(check_board(board));
 
@@ -23,55 +80,149 @@ static void perft(int32_t depth, Board_t *board, uint64_t *count) {
     return;
   }
 
+  uint64_t cached;
+  if(ht && depth > 1 && probe_perft_hash(ht, board->hashkey, depth, &cached)) {
+    *count += cached;
+    return;
+  }
+
+  uint64_t before = *count;
+
   MoveList_t list;
   generate_all_moves(board, &list);
 
+#ifndef USE_PSEUDO_LEGAL
+  if(depth == 1) {
+    *count += list.count;
+    return;
+  }
+#endif
+
   for(int32_t move_num = 0; move_num < list.count; ++move_num) {
     if(!make_move(board, list.moves[move_num].move)) continue;
 
-    perft(depth - 1, board, count);
+    perft(depth - 1, board, count, ht);
     take_move(board);
   }
 
+  if(ht && depth > 1) store_perft_hash(ht, board->hashkey, depth, *count - before);
+
   return;
 }
 
+/**
+ * Keeps grabbing root moves from the job and counting the leaves under them
+ * until there aren't any left. Run by every perft thread (and by the calling thread
+ * when there is only one)
+ */
+static void *perft_worker(void *arg) {
+  PerftThread_t *thread = (PerftThread_t *)arg;
+  PerftJob_t *job = thread->job;
+  Board_t *board = &thread->board;
+
+  while(true) {
+#ifndef WIN32
+    pthread_mutex_lock(&job->lock);
+#endif
+    int32_t move_num = job->next++;
+#ifndef WIN32
+    pthread_mutex_unlock(&job->lock);
+#endif
+
+    if(move_num >= job->list.count) break;
+
+    if(!make_move(board, job->list.moves[move_num].move)) continue;
+
+    uint64_t leaves = 0;
+    perft(job->depth - 1, board, &leaves, job->ht);
+    job->leaves[move_num] = leaves;
+    job->legal[move_num] = true;
+    take_move(board);
+  }
+
+  return NULL;
+}
+
 /**
  * This function is the wrapper function for the above perft testing func.
- * If being run from the stresstest program, don't run the print statements here
+ * With divide, the leaf count under every root move gets printed too, which is
+ * the quickest way to narrow down which move the generator gets wrong.
+ * The root moves get split between the given number of threads, each with their own
+ * copy of the board. ht is an optional hash (see init_hashset) shared by all of the
+ * threads to cache subtree counts, pass NULL to go without. It doesn't have to be
+ * cleared between tests since the counts only depend on the position
  */
-uint64_t perft_test(int32_t depth, Board_t *board, bool stress) {
+uint64_t perft_test(int32_t depth, Board_t *board, bool divide, int32_t threads, HashTable_t *ht) {
 
   // always good to sanity check
   ASSERT(check_board(board));
+  ASSERT(threads >= 1 && threads <= MAX_THREADS);
 
-  if(!stress) {
-    print_board(board);
-    printf("\nStarting perft test to depth: %d\n", depth);
+  PerftJob_t *job = calloc(1, sizeof(PerftJob_t));
+  PerftThread_t *pool = malloc(threads * sizeof(PerftThread_t));
+  if(!job || !pool) {
+    fprintf(stderr, "failed to allocate memory for the perft threads.\n");
+    exit(1);
   }
 
-  uint64_t total = 0;
+  job->board = board;
+  job->depth = depth;
+  job->ht = ht;
+  generate_all_moves(board, &job->list);
 
-  MoveList_t list;
-  generate_all_moves(board, &list);
+  // the calling thread does its share of the work as pool[0]
+  pool[0].board = *board;
+  pool[0].job = job;
 
-  int32_t start = get_time_millis();
-  for(int32_t move_num = 0; move_num < list.count; ++move_num) {
+#ifdef WIN32
 
-    int32_t move = list.moves[move_num].move;
+  perft_worker(&pool[0]);
 
-    if(!make_move(board, move)) continue;
+#else
 
-    uint64_t leaves = 0;
-    perft(depth - 1, board, &leaves);
+  pthread_mutex_init(&job->lock, NULL);
+
+  // if a thread can't be started, the ones we have do the work
+  int32_t started = 1;
+  for(int32_t idx = 1; idx < threads; ++idx) {
+    pool[idx].board = *board;
+    pool[idx].job = job;
+    if(pthread_create(&pool[idx].handle, NULL, perft_worker, &pool[idx])) break;
+    ++started;
+  }
+  perft_worker(&pool[0]);
+  for(int32_t idx = 1; idx < started; ++idx) pthread_join(pool[idx].handle, NULL);
+
+  pthread_mutex_destroy(&job->lock);
+
+#endif
+
+  uint64_t total = 0;
+  for(int32_t move_num = 0; move_num < job->list.count; ++move_num) {
+    if(!job->legal[move_num]) continue;
+
+    uint64_t leaves = job->leaves[move_num];
     total += leaves;
-    take_move(board);
 
-    if(!stress) printf("move %d (%s): %lld possible positions\n", move_num + 1, print_move(move), leaves);
+    if(divide) printf("%s: %llu\n", print_move(job->list.moves[move_num].move), (unsigned long long)leaves);
   }
 
-  int32_t end = get_time_millis();
-  if(!stress) printf("\nTest complete. %lld leaf nodes visited. Time elapsed: %d ms\n", total, end - start);
+  free(pool);
+  free(job);
 
   return total;
 }
+
+/**
+ * Runs a perft test on the current position and reports how many leaves it found
+ * and how fast. Used for the `perft` and `divide` commands, so there's no perft hash:
+ * the point is seeing how fast the move generator is on this binary
+ */
+void print_perft(int32_t depth, Board_t *board, bool divide, int32_t threads) {
+  unsigned long start = get_time_millis();
+  uint64_t nodes = perft_test(depth, board, divide, threads, NULL);
+  unsigned long elapsed = get_time_millis() - start;
+
+  printf("\nNodes: %llu Time: %lu ms Nodes/sec: %llu\n", (unsigned long long)nodes, elapsed,
+    (unsigned long long)(nodes * 1000 / (elapsed ? elapsed : 1)));
+}
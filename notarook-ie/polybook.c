@@ -13,10 +13,72 @@ static const int32_t poly_kind_of_piece[13] = {-1, 1, 3, 5, 7, 9, 11, 0, 2, 4, 6
 /**
  * Initializes the given book.
  * Bookstr is set to the name of the book you can use (set in engine.c)
+ *
+ * The book file gets mapped into memory read only instead of being read in.
+ * That way startup doesn't have to wait on reading the whole file, only the
+ * pages we actually look at get loaded, and every engine running on the
+ * machine shares the same copy of the book.
  */
+#ifndef WIN32
+bool init_polybook(Polybook_t *book, char *bookstr) {
+  int fd = open(bookstr, O_RDONLY);
+  book->entries = NULL;
+  book->num_entries = 0;
+  book->mapped_size = 0;
+
+  if(fd < 0) {
+    fprintf(stderr, "book file failed to open!\n");
+    exit(1);
+  }
+
+  // figure out file size
+  struct stat st;
+  if(fstat(fd, &st) < 0) {
+    fprintf(stderr, "couldn't get the size of the book file.\n");
+    close(fd);
+    return false;
+  }
+
+  // file is corrupt (too small to make sense)
+  // this won't be a fatal error; we'll just go at it without the book
+  if(st.st_size < (off_t)sizeof(PolybookEntry_t)) {
+    fprintf(stderr, "book has no entries.\n");
+    close(fd);
+    return false;
+  }
+
+  void *mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+  // the mapping keeps the file around on its own, so we're done with the descriptor
+  close(fd);
+
+  if(mapped == MAP_FAILED) {
+    fprintf(stderr, "failed to map the book file into memory.\n");
+    return false;
+  }
+
+  book->entries = mapped;
+  book->num_entries = (unsigned long)st.st_size / sizeof(PolybookEntry_t);
+  book->mapped_size = (size_t)st.st_size;
+  return true;
+}
+
+/**
+ * Resets a given book
+ */
+void clean_polybook(Polybook_t *book) {
+  // unmap exactly what got mapped (the file doesn't have to be a whole number of entries)
+  if(book->entries) munmap((void *)book->entries, book->mapped_size);
+  book->num_entries = 0;
+  book->mapped_size = 0;
+  book->entries = NULL;
+}
+#else
+// no mmap on windows, so read the whole book in instead
 bool init_polybook(Polybook_t *book, char *bookstr) {
   FILE *bk = fopen(bookstr, "rb");
   book->entries = NULL;
+  book->mapped_size = 0; // nothing gets mapped here
 
   if(!bk) {
     fprintf(stderr, "book file failed to open!\n");
@@ -38,19 +100,20 @@ bool init_polybook(Polybook_t *book, char *bookstr) {
 
   book->num_entries = end / (unsigned long)sizeof(PolybookEntry_t);
 
-  book->entries = calloc(book->num_entries, sizeof(PolybookEntry_t));
+  PolybookEntry_t *entries = calloc(book->num_entries, sizeof(PolybookEntry_t));
 
   // check if memory alloc succeeded
   // it'll prob never fail but it never hurts to be careful
-  if(!book->entries) {
+  if(!entries) {
     fprintf(stderr, "memory alloc failed!\n");
     fclose(bk);
     exit(1);
   }
 
   // read in the entries
-  size_t ent = fread(book->entries, sizeof(PolybookEntry_t), book->num_entries, bk);
+  size_t ent = fread(entries, sizeof(PolybookEntry_t), book->num_entries, bk);
   fclose(bk);
+  book->entries = entries;
   return ent > 0 && ent == book->num_entries;
 }
 
@@ -58,10 +121,11 @@ bool init_polybook(Polybook_t *book, char *bookstr) {
  * Resets a given book
  */
 void clean_polybook(Polybook_t *book) {
-  free(book->entries);
+  free((void *)book->entries);
   book->num_entries = 0;
   book->entries = NULL;
 }
+#endif
 
 /**
  * Check if an en passant pawn has enemy pawns adjacent to actually
@@ -132,9 +196,13 @@ static uint64_t polykey_from_board(const Board_t *board) {
 }
 
 /**
- * Flip between book format and our format for the moves
+ * Flip between book format and our format for the moves.
+ * The squares and promotion piece come straight out of the 16 bits, and find_move_masked
+ * (see movegen.c) builds our move from them and makes sure it can be played here.
+ * pinned and targets are the position's legal_masks, worked out once per lookup
  */
-static uint32_t convert_poly_to_internal(uint16_t move, Board_t *board) {
+static uint32_t convert_poly_to_internal(uint16_t move, const Board_t *board,
+                                         const uint64_t pinned, const uint64_t targets) {
 
   // this comes from the website
   int32_t ff = (move >> 6) & 7;
@@ -143,57 +211,67 @@ static uint32_t convert_poly_to_internal(uint16_t move, Board_t *board) {
   int32_t tr = (move >> 3) & 7;
   int32_t pp = (move >> 12) & 7; // promotion
 
-  char movestr[6];
-  // no promotion piece
-  if(pp == 0) {
-    snprintf(movestr, sizeof(movestr), "%c%c%c%c",
-      FILE_CHAR[ff], RANK_CHAR[fr], FILE_CHAR[tf], RANK_CHAR[tr]);
-  } else {
-    char prom = 'q';
-    switch(pp) {
-      case 1:
-        prom = 'n';
-        break;
-      case 2:
-        prom = 'b';
-        break;
-      case 3:
-        prom = 'r';
-        break;
-    }
-    snprintf(movestr, sizeof(movestr), "%c%c%c%c%c",
-      FILE_CHAR[ff], RANK_CHAR[fr], FILE_CHAR[tf], RANK_CHAR[tr], prom);
+  int32_t from = CONVERT_COORDS(ff, fr);
+  int32_t to = CONVERT_COORDS(tf, tr);
+
+  // polyglot writes castling as the king taking its own rook (e1h1 instead of e1g1)
+  int32_t piece = board->pieces[from];
+  if(PIECE_KING[piece] && (from == E1 || from == E8) && (tf == FILE_H || tf == FILE_A) && tr == fr) {
+    to = (tf == FILE_H) ? from + 2 : from - 2;
   }
 
-  // we already wrote a move parser, so go from their representation to ours via
-  // our parser
-  return parse_move(movestr, board);
+  // 1 through 4 are knight, bishop, rook, queen
+  static const int32_t promotions[2][5] = {
+    {EMPTY, wN, wB, wR, wQ},
+    {EMPTY, bN, bB, bR, bQ}
+  };
+  int32_t promoted = (pp <= 4) ? promotions[board->side][pp] : EMPTY;
+
+  return find_move_masked(board, from, to, promoted, pinned, targets);
+}
+
+/**
+ * Finds the index of the first entry in the book with the given key
+ * (or where it would be if it isn't there). Polyglot books are sorted by key,
+ * so this is a binary search instead of going through every entry.
+ * Annoyingly, the book entries are big endian so we gotta flip em
+ */
+static unsigned long first_book_entry(const Polybook_t *book, const uint64_t poly_key) {
+  unsigned long low = 0, high = book->num_entries;
+
+  while(low < high) {
+    unsigned long mid = low + (high - low) / 2;
+    if(ntohll(book->entries[mid].key) < poly_key) low = mid + 1;
+    else high = mid;
+  }
+  return low;
 }
 
 /**
  * Called by the engine in order to find a book move for the position.
- * This isn't the most efficient way to do this, and maybe I'll come back
- * to this and will make it more efficient. Maybe.
+ * All of the entries for a position sit next to each other in the book,
+ * so find the first one and read until the key changes
  */
 uint32_t get_book_move(Board_t *board, const Polybook_t book) {
-  PolybookEntry_t *entry;
+  const PolybookEntry_t *entry;
   int32_t count = 0;
   uint16_t move;
   uint64_t poly_key = polykey_from_board(board);
   uint32_t book_moves[MAX_BOOK_MOVES]; // stores the moves in the engine's format
   uint32_t tmp = NOMOVE;
 
-  // loop through the book entries one by one
-  // annoyingly, the book entries are big endian so we gotta flip em
-  for(entry = book.entries; entry < book.entries + book.num_entries; ++entry) {
-    if(poly_key == ntohll(entry->key)) {
-      move = ntohs(entry->move);
-      tmp = convert_poly_to_internal(move, board);
-
-      if(tmp != NOMOVE) {
-        book_moves[count++] = tmp;
-        if(count > MAX_BOOK_MOVES) break;
-      }
+  // the pins and checks are the same for every entry, so only work them out once
+  uint64_t pinned, targets;
+  legal_masks(board, &pinned, &targets);
+
+  for(entry = book.entries + first_book_entry(&book, poly_key);
+      entry < book.entries + book.num_entries && ntohll(entry->key) == poly_key; ++entry) {
+    move = ntohs(entry->move);
+    tmp = convert_poly_to_internal(move, board, pinned, targets);
+
+    if(tmp != NOMOVE) {
+      book_moves[count++] = tmp;
+      if(count >= MAX_BOOK_MOVES) break;
     }
   }
 
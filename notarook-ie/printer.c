@@ -58,9 +58,11 @@ char * print_move(const uint32_t move) {
  * Parses a move in algebraic notation (e.g. g7g8q for pawn promotion to queen)
  * from standard in
  *
- * Could this have been written better? yes. Do I care? no
+ * The move gets built straight from the squares instead of searching every move
+ * in the position for it (see find_move in movegen.c). `notarookie parsebench`
+ * compares the two ways
  */
-uint32_t parse_move(char *str, Board_t *board) {
+uint32_t parse_move(const char *str, const Board_t *board) {
 
   // error check
   // yes, this assumes the formatting is very specific but ¯\_(ツ)_/¯
@@ -75,39 +77,16 @@ uint32_t parse_move(char *str, Board_t *board) {
 
   ASSERT(square_on_board(from) && square_on_board(to));
 
-  // generate all moves in this position and find the
-  // move that matches what was given
-  MoveList_t list;
-  generate_all_moves(board, &list);
-  uint32_t move = NOMOVE, promotion_piece = EMPTY;
-
-  for(int32_t ind = 0; ind < list.count; ++ind) {
-    move = list.moves[ind].move;
-
-    // if the move matches our generated moves, check for
-    // promotion or just return
-    if(FROMSQ(move) == from && TOSQ(move) == to) {
-      promotion_piece = PROMOTED(move);
-      if(promotion_piece != EMPTY) {
-        // rook promotion
-        if(IsRQ(promotion_piece) && !IsBQ(promotion_piece) && str[4] == 'r') {
-          return move;
-        // bishop promotion
-        } else if(!IsRQ(promotion_piece) && IsBQ(promotion_piece) && str[4] == 'b') {
-          return move;
-        // queen promotion
-        } else if(IsRQ(promotion_piece) && IsBQ(promotion_piece) && str[4] == 'q') {
-          return move;
-        // knight promotion
-        } else if(IsKn(promotion_piece) && str[4] == 'n') {
-          return move;
-        }
-        continue;
-      }
-      return move;
-    }
+  // promotion pieces are given in lowercase no matter whose move it is
+  int32_t promoted = EMPTY;
+  switch(str[4]) {
+    case 'q': promoted = (board->side == WHITE) ? wQ : bQ; break;
+    case 'r': promoted = (board->side == WHITE) ? wR : bR; break;
+    case 'b': promoted = (board->side == WHITE) ? wB : bB; break;
+    case 'n': promoted = (board->side == WHITE) ? wN : bN; break;
   }
-  return NOMOVE;
+
+  return find_move(board, from, to, promoted);
 }
 
 /**
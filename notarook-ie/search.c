@@ -5,43 +5,89 @@
 #include "functions.h"
 #include "constants.h"
 
+// everything one Lazy SMP helper thread needs for its own search.
+// each one gets its own board (which means its own killers and history too)
+// and its own node count; the hashset is the only thing shared.
+// (no pthreads on windows, see constants.h, so the main thread searches alone there)
+typedef struct SearchThread {
+  Board_t board;
+  SearchInfo_t info;
+#ifndef WIN32
+  pthread_t handle;
+#endif
+  int32_t id;
+} SearchThread_t;
+
+// the helper threads for the search currently running
+static SearchThread_t *helpers = NULL;
+static int32_t num_helpers = 0;
+
+// how many plies to take off of a late quiet move, indexed by depth then by
+// how many legal moves have been searched at the node (see init_reductions)
+static int32_t REDUCTIONS[MAX_DEPTH][MAX_POSITION_MOVES];
+
 /**
- * Called every so often to check if the time is up or the GUI
- * has sent an interrupt
+ * Natural log, good enough for building the table below.
+ * (math.h's INFINITY clashes with ours, and this saves linking in libm
+ * for one loop at startup.) Pulls out powers of two first so the series
+ * only has to work for numbers between 1 and 2
  */
-static void check_up(SearchInfo_t *info) {
-  // we've run out of time
-  if(info->timeset && get_time_millis() > info->stoptime) {
-    info->stopped = true;
+static double natural_log(double x) {
+  const double LN2 = 0.69314718055994530942;
+  int32_t exponent = 0;
+
+  while(x >= 2.0) {
+    x /= 2.0;
+    ++exponent;
   }
 
-  // check for commands like "quit" from console/GUI
-  read_input(info);
+  // ln(x) = 2 * (y + y^3/3 + y^5/5 + ...) where y = (x - 1) / (x + 1)
+  double y = (x - 1.0) / (x + 1.0), y2 = y * y, term = y, sum = 0.0;
+  for(int32_t n = 1; n < 40; n += 2) {
+    sum += term / n;
+    term *= y2;
+  }
+
+  return exponent * LN2 + 2.0 * sum;
 }
 
 /**
- * Swaps out the move we're looking at to find the better score at that point
- * Essential for better move ordering, speeding up our entire search.
+ * Fills in the late move reduction table. The reduction grows with the log of
+ * both the depth and the move number: the deeper we are and the further down the
+ * move ordering a move is, the less likely it is to be any good.
+ * The constants are the same ballpark as what most engines use
  */
-static void pick_next_move(int32_t move_num, MoveList_t *list) {
-  Move_t temp;
-  int32_t best_score = 0;
-  int32_t index;
-  int32_t best_num = move_num;
-
-  // find the best move according to which move has
-  // the highest score
-  for(index = move_num; index < list->count; ++index) {
-    if(list->moves[index].score > best_score) {
-      best_score = list->moves[index].score;
-      best_num = index;
+void init_reductions(void) {
+  for(int32_t depth = 0; depth < MAX_DEPTH; ++depth) {
+    for(int32_t move_num = 0; move_num < MAX_POSITION_MOVES; ++move_num) {
+      if(!depth || !move_num) {
+        REDUCTIONS[depth][move_num] = 0;
+        continue;
+      }
+      REDUCTIONS[depth][move_num] = (int32_t)(0.75 + natural_log(depth) * natural_log(move_num) / 2.25);
     }
   }
+}
+
+/**
+ * Called every so often to check if the time is up.
+ * Interrupts from the GUI don't need checking for, the input thread
+ * sets info->stopped itself (see util.c)
+ */
+static void check_up(SearchInfo_t *info) {
+  // helper threads just do whatever the main search thread does
+  if(info->parent) {
+    ATOMIC_STORE(info->stopped, ATOMIC_LOAD(info->parent->stopped));
+    return;
+  }
 
-  // swap out the move at our index for the best move
-  temp = list->moves[move_num];
-  list->moves[move_num] = list->moves[best_num];
-  list->moves[best_num] = temp;
+  // we've run out of time (which isn't running yet if we're pondering)
+  if(info->timeset && !ATOMIC_LOAD(info->pondering) && get_time_millis() > info->stoptime) {
+    ATOMIC_STORE(info->stopped, true);
+  }
+
+  // answer anything the input thread couldn't (like "isready")
+  check_input();
 }
 
 /**
@@ -79,11 +125,13 @@ static void clear_for_search(SearchInfo_t *info, Board_t *board) {
     }
   }
 
-  // clear the principle variation table
-  clear_hashset(&board->pvt);
+  // start a new generation in the transposition table. We don't clear it:
+  // what we learned last search is still useful, and the old entries will
+  // get overwritten as we go
+  board->hash_table.age++;
   board->ply = 0;
 
-  info->stopped = false;
+  ATOMIC_STORE(info->stopped, false);
   info->nodes = 0;
   info->fail_high = info->fail_high_first = 0.0;
 }
@@ -115,24 +163,22 @@ static int32_t quiescence(int32_t alpha, int32_t beta, Board_t *board, SearchInf
 
   if(score > alpha) alpha = score;
 
-  // this next bit is basically just alpha-beta search again
-  MoveList_t list;
-  generate_all_captures(board, &list);
-  int32_t idx;
+  // this next bit is basically just alpha-beta search again.
+  // the picker only hands out captures that don't lose material here
+  MovePicker_t picker;
+  init_move_picker(board, &picker, NOMOVE, false);
+  uint32_t move;
   int32_t legal = 0;
-  int32_t old_alpha = alpha;
-  uint32_t best_move = NOMOVE;
   score = -INFINITY;
 
-  for(idx = 0; idx < list.count; ++idx) {
-    pick_next_move(idx, &list);
-    if(!make_move(board, list.moves[idx].move)) continue;
+  while((move = next_move(board, &picker)) != NOMOVE) {
+    if(!make_move(board, move)) continue;
 
     ++legal;
     score = -quiescence(-beta, -alpha, board, info);
     take_move(board);
 
-    if(info->stopped) return 0;
+    if(ATOMIC_LOAD(info->stopped)) return 0;
 
     // we found a good move
     if(score > alpha) {
@@ -143,16 +189,11 @@ static int32_t quiescence(int32_t alpha, int32_t beta, Board_t *board, SearchInf
         return beta; // beta cutoff
       }
       alpha = score;
-      best_move = list.moves[idx].move;
     }
   }
 
-  // this means our best move now is better than our previous, so
-  // put it as part of the best line
-  if(alpha != old_alpha) {
-    store_move(board, best_move);
-  }
-
+  // nothing gets stored in the hashset from here: these nodes have no depth
+  // left, so they'd just push out the entries that actually matter
   return alpha;
 }
 
@@ -181,12 +222,18 @@ static int32_t alpha_beta_search(int32_t alpha, int32_t beta, int32_t depth, Boa
   // we've reached the deepest we will search in our board
   if(board->ply > MAX_DEPTH - 1) return eval_position(board);
 
+  int32_t score = -INFINITY;
+  uint32_t pv_move = NOMOVE;
+
+  // if we've already searched this position at least this deeply, just reuse the result
+  // (not at the root though, we always want a real search and best line there)
+  if(probe_hash_entry(board, &pv_move, &score, alpha, beta, depth) && board->ply) return score;
+
   // add in some checks (hah) for if we're being checked at all
   // increase the depth because maybe there's a way out
   bool in_check = square_attacked(board->kings_sq[board->side], board->side ^ 1, board);
   if(in_check) ++depth;
 
-  int32_t score = -INFINITY;
 
   // explaining each condition in order, we don't do recursive null moves (hence the param)
   // if we're in check, we can't do nothing (obviously)
@@ -197,46 +244,75 @@ static int32_t alpha_beta_search(int32_t alpha, int32_t beta, int32_t depth, Boa
     make_null_move(board);
     score = -alpha_beta_search(-beta, -beta + 1, depth - 4, board, info, false);
     take_null_move(board);
-    if(info->stopped) return 0;
+    if(ATOMIC_LOAD(info->stopped)) return 0;
 
     // if our opponent's best move is greater than or equal to beta, this means that
     // our position is too stronk for them
     if(score >= beta) return beta;
   }
 
-  MoveList_t list;
-  generate_all_moves(board, &list);
+  // we're still in the main line, so the picker hands out that main line move first
+  // (before it even generates anything else)
+  MovePicker_t picker;
+  init_move_picker(board, &picker, pv_move, true);
+  uint32_t move;
 
   int32_t legal = 0; // to check for checkmate or stalemate
-  int32_t idx = 0;
   int32_t old_alpha = alpha;
   uint32_t best_move = NOMOVE;
+  int32_t best_score = -INFINITY;
   score = -INFINITY;
-  uint32_t pv_move = find_move(board);
 
-  // we're still in the main line, so search that main line move first
-  if(pv_move != NOMOVE) {
-    for(idx = 0; idx < list.count; ++idx) {
-      if(list.moves[idx].move == pv_move) {
-        list.moves[idx].score = 2000000;
-        break;
-      }
-    }
-  }
-
-  for(idx = 0; idx < list.count; ++idx) {
-
-    pick_next_move(idx, &list);
-    if(!make_move(board, list.moves[idx].move)) continue;
+  while((move = next_move(board, &picker)) != NOMOVE) {
+    if(!make_move(board, move)) continue;
 
     ++legal;
 
+    // late move reductions: by the time we're a few moves in, the good moves have most
+    // likely been searched already (hash move, captures, killers, history), so quiet moves
+    // this late get a shallower search. Moves that get us out of check or give check
+    // aren't reduced, since those are the ones that tend to hide tactics
+    int32_t reduction = 0;
+    if(depth >= LMR_MIN_DEPTH && legal > LMR_MIN_MOVES && !in_check
+        && !(move & (MFLAGCAP | MFLAGPR))
+        && move != board->search_killers[0][board->ply - 1]
+        && move != board->search_killers[1][board->ply - 1]
+        && !square_attacked(board->kings_sq[board->side], board->side ^ 1, board)) {
+      reduction = REDUCTIONS[(depth < MAX_DEPTH) ? depth : MAX_DEPTH - 1][legal];
+
+      // always leave at least one ply of real search
+      if(reduction > depth - 2) reduction = depth - 2;
+    }
+
     // negamax now
-    // bounds are flipped cause we're looking from the opposite perspective
-    score = -alpha_beta_search(-beta, -alpha, depth - 1, board, info, true);
+    // bounds are flipped cause we're looking from the opposite perspective.
+    // principal variation search: the first move is searched with the full window, and
+    // with decent move ordering it's usually the best. Every move after that just has to
+    // prove it's no better than alpha, which a zero width window does way more cheaply.
+    // if one of them does beat alpha after all, search it again properly
+    if(legal == 1) {
+      score = -alpha_beta_search(-beta, -alpha, depth - 1, board, info, true);
+    } else {
+      score = -alpha_beta_search(-alpha - 1, -alpha, depth - 1 - reduction, board, info, true);
+
+      // the reduced search says this move might be good after all, so check with the full depth
+      if(reduction && score > alpha && !ATOMIC_LOAD(info->stopped)) {
+        score = -alpha_beta_search(-alpha - 1, -alpha, depth - 1, board, info, true);
+      }
+      if(score > alpha && score < beta && !ATOMIC_LOAD(info->stopped)) {
+        score = -alpha_beta_search(-beta, -alpha, depth - 1, board, info, true);
+      }
+    }
     take_move(board);
 
-    if(info->stopped) return 0;
+    if(ATOMIC_LOAD(info->stopped)) return 0;
+
+    // keep track of the best move even if it doesn't beat alpha
+    // so that the hashset has something to order with next time
+    if(score > best_score) {
+      best_score = score;
+      best_move = move;
+    }
 
     if(score > alpha) {
       if(score >= beta) {
@@ -245,18 +321,19 @@ static int32_t alpha_beta_search(int32_t alpha, int32_t beta, int32_t depth, Boa
         info->fail_high++;
 
         // non capture moves that cause beta cutoffs are killers
-        if(!(list.moves[idx].move & MFLAGCAP)) {
+        if(!(move & MFLAGCAP)) {
           board->search_killers[1][board->ply] = board->search_killers[0][board->ply];
-          board->search_killers[0][board->ply] = list.moves[idx].move;
+          board->search_killers[0][board->ply] = move;
         }
+
+        store_hash_entry(board, best_move, beta, HFBETA, depth);
         return beta; // beta cutoff
       }
 
       alpha = score;
-      best_move = list.moves[idx].move;
 
       // non capture moves that beat alpha are history improvers
-      if(!(list.moves[idx].move & MFLAGCAP)) {
+      if(!(move & MFLAGCAP)) {
         board->search_history[board->pieces[FROMSQ(best_move)]][TOSQ(best_move)] += depth;
       }
     }
@@ -270,13 +347,115 @@ static int32_t alpha_beta_search(int32_t alpha, int32_t beta, int32_t depth, Boa
     }
   }
 
+  // if we beat alpha we know the exact score, otherwise all we know
+  // is that the position is no better than alpha
   if(alpha != old_alpha) {
-    store_move(board, best_move);
+    store_hash_entry(board, best_move, best_score, HFEXACT, depth);
+  } else {
+    store_hash_entry(board, best_move, alpha, HFALPHA, depth);
   }
 
   return alpha;
 }
 
+#ifndef WIN32
+
+/**
+ * Entry point for each helper thread in Lazy SMP.
+ * Helpers run their own iterative deepening on their own copy of the board
+ * and never report anything. The speedup comes from them filling up the shared
+ * hashset with results that the main thread then gets to skip searching.
+ */
+static void *helper_search(void *arg) {
+  SearchThread_t *thread = (SearchThread_t *)arg;
+
+  // odd numbered helpers start a depth ahead so that the threads
+  // aren't all searching the exact same tree
+  for(int32_t curr_depth = 1 + (thread->id & 1); curr_depth <= thread->info.depth; ++curr_depth) {
+    alpha_beta_search(-INFINITY, INFINITY, curr_depth, &thread->board, &thread->info, true);
+    if(ATOMIC_LOAD(thread->info.stopped)) break;
+  }
+
+  return NULL;
+}
+
+#endif
+
+/**
+ * Spins up the helper threads (one less than the thread count
+ * since the main thread searches too)
+ */
+static void start_helpers(const Board_t *board, SearchInfo_t *info) {
+  num_helpers = 0;
+
+  if(info->threads <= 1) return;
+
+#ifdef WIN32
+
+  // no helpers without pthreads
+  (void)board;
+
+#else
+
+  helpers = malloc((info->threads - 1) * sizeof(SearchThread_t));
+
+  // no memory means no helpers, but we can still search
+  if(!helpers) return;
+
+  for(int32_t idx = 0; idx < info->threads - 1; ++idx) {
+    SearchThread_t *thread = &helpers[idx];
+
+    // copy the board and search settings, and point the helper at
+    // the main thread's info so it knows when to stop
+    thread->board = *board;
+    thread->info = *info;
+    thread->info.nodes = 0;
+    thread->info.parent = info;
+    thread->id = idx + 1;
+
+    if(pthread_create(&thread->handle, NULL, helper_search, thread)) break;
+    ++num_helpers;
+  }
+
+#endif
+}
+
+/**
+ * Tells the helper threads to stop, waits for them to finish, and cleans up
+ */
+static void stop_helpers(SearchInfo_t *info) {
+  ATOMIC_STORE(info->stopped, true);
+
+#ifndef WIN32
+  for(int32_t idx = 0; idx < num_helpers; ++idx) {
+    pthread_join(helpers[idx].handle, NULL);
+  }
+#endif
+
+  // fold the helpers' nodes into the main count so that it covers every thread
+  // once the search is over
+  for(int32_t idx = 0; idx < num_helpers; ++idx) {
+    info->nodes += helpers[idx].info.nodes;
+  }
+
+  free(helpers);
+  helpers = NULL;
+  num_helpers = 0;
+}
+
+/**
+ * Counts up the nodes searched by every thread. The helper counts are read
+ * while they're still running, so this is only approximately right (that's fine for printing)
+ */
+static long total_nodes(const SearchInfo_t *info) {
+  long nodes = info->nodes;
+
+  for(int32_t idx = 0; idx < num_helpers; ++idx) {
+    nodes += helpers[idx].info.nodes;
+  }
+  return nodes;
+}
+
 /**
  * Does the iterative deepening search
  * Due to the idea of principle variation, this is more efficient than
@@ -290,14 +469,18 @@ void search_position(Board_t *board, SearchInfo_t *info, bool use_book, const Po
   bool nowait = false;
 
   clear_for_search(info, board);
+  input_search_started();
 
   // change "thinking" for blitz/bullet games
   if(info->timeset && info->game_mode == XBOARDMODE)
     // we'll say that 3 minutes or fewer defines a blitz/bullet game
     nowait = info->initial_time <= 3 && info->initial_time > 0;
 
+  info->ponder_move = NOMOVE;
+
   // use the openings book
-  if(use_book) {
+  // (not while pondering though: a book move would be played without waiting for the opponent)
+  if(use_book && !ATOMIC_LOAD(info->pondering)) {
     printf("Looking for position in opening book...\n");
     best_move = get_book_move(board, book);
   }
@@ -308,18 +491,46 @@ void search_position(Board_t *board, SearchInfo_t *info, bool use_book, const Po
   if(best_move != NOMOVE) {
     int32_t wait_time = (nowait) ? MIN_WAIT_TIME : MIN_WAIT_TIME + ((rand() % (3 - 1 + 1)) + 1);
     printf("Found position in openings book. Skipping search, waiting for %ds, then playing...\n", wait_time);
+    fflush(stdout);
     sleep(wait_time);
   }
 
   // no book move, so time to do our IDDFS
   if(best_move == NOMOVE) {
-    printf("Didn't find a book move. searching...\n");
+    if(info->game_mode != BENCHMODE) printf("Didn't find a book move. searching...\n");
+
+    // get the helper threads going (if we're using any)
+    start_helpers(board, info);
+
     // iterative deepening begins
     for(curr_depth = 1; curr_depth <= info->depth; ++curr_depth) {
-      // first, find the best move
-      best_score = alpha_beta_search(-INFINITY, INFINITY, curr_depth, board, info, true);
+      // first, find the best move.
+      // the score usually doesn't change much from one depth to the next, so search
+      // a small window around the last one (aspiration window). A narrower window
+      // prunes more, but if the score falls outside of it we have to widen the window
+      // on that side and search again
+      int32_t alpha = -INFINITY, beta = INFINITY, delta = ASPIRATION_WINDOW;
+      if(curr_depth >= ASPIRATION_DEPTH && abs(best_score) < IS_MATE) {
+        alpha = best_score - delta;
+        beta = best_score + delta;
+      }
 
-      if(info->stopped) break;
+      while(true) {
+        int32_t score = alpha_beta_search(alpha, beta, curr_depth, board, info, true);
+        if(ATOMIC_LOAD(info->stopped)) break;
+
+        if(score <= alpha && alpha > -INFINITY) {
+          alpha = (score - delta > -INFINITY) ? score - delta : -INFINITY;
+        } else if(score >= beta && beta < INFINITY) {
+          beta = (score + delta < INFINITY) ? score + delta : INFINITY;
+        } else {
+          best_score = score;
+          break;
+        }
+        delta *= 2;
+      }
+
+      if(ATOMIC_LOAD(info->stopped)) break;
 
       // get (and print out) the pv line for the depth
       pv_moves = get_pv_line(curr_depth, board);
@@ -330,11 +541,11 @@ void search_position(Board_t *board, SearchInfo_t *info, bool use_book, const Po
       // print based on the mode
       if(info->game_mode == UCIMODE) {
         printf("info score cp %d depth %d nodes %ld time %lu ",
-          best_score, curr_depth, info->nodes, get_time_millis() - info->starttime);
+          best_score, curr_depth, total_nodes(info), get_time_millis() - info->starttime);
       } else if(info->game_mode == XBOARDMODE && info->post_thinking) {
-        printf("%d %d %lu %ld ", curr_depth, best_score, (get_time_millis() - info->starttime) / 10, info->nodes);
+        printf("%d %d %lu %ld ", curr_depth, best_score, (get_time_millis() - info->starttime) / 10, total_nodes(info));
       } else if(info->post_thinking) {
-        printf("score:%d depth:%d nodes:%ld time:%lu(ms) ", best_score, curr_depth, info->nodes, get_time_millis() - info->starttime);
+        printf("score:%d depth:%d nodes:%ld time:%lu(ms) ", best_score, curr_depth, total_nodes(info), get_time_millis() - info->starttime);
       }
 
       // print the current principal variation line if required
@@ -345,23 +556,63 @@ void search_position(Board_t *board, SearchInfo_t *info, bool use_book, const Po
           printf(" %s", print_move(board->pv_array[idx]));
         }
         printf("\n");
+
+        // send the whole line out at once (stdout is buffered, see engine.c)
+        fflush(stdout);
+      }
+    }
+
+    // the PV's second move is what we expect the opponent to play back (what we ponder on)
+    if(best_move != NOMOVE && pv_moves > 1) info->ponder_move = board->pv_array[1];
+
+    // out of things to search but the opponent hasn't moved yet, and
+    // we're not allowed to answer before they do
+    if(ATOMIC_LOAD(info->pondering)) wait_for_ponder_end(info);
+
+    // we're done, so the helpers are too
+    stop_helpers(info);
+
+    // told to stop before depth 1 was even done (e.g. "go" and "stop" sent
+    // back to back), but any legal move beats not having one
+    if(best_move == NOMOVE) {
+      MoveList_t list;
+      generate_all_moves(board, &list);
+      for(int32_t idx = 0; idx < list.count; ++idx) {
+        if(!make_move(board, list.moves[idx].move)) continue;
+        take_move(board);
+        best_move = list.moves[idx].move;
+        break;
       }
     }
   }
 
+  // anything the GUI sends from here on out is for the protocol loops
+  input_search_stopped();
+
+  // an xboard ponder search that got interrupted is just thrown away
+  // (the loop takes back the guessed move, see xboard.c)
+  bool ponder_miss = ATOMIC_LOAD(info->pondering) && info->game_mode == XBOARDMODE;
+  ATOMIC_STORE(info->pondering, false);
+  if(ponder_miss) return;
+
   // UCI protocol dictates that all we do is print our best move
+  // (and the move we'd like to ponder on, if we have one)
   if(info->game_mode == UCIMODE) {
-    printf("bestmove %s\n", print_move(best_move));
+    printf("bestmove %s", print_move(best_move));
+    if(info->ponder_move != NOMOVE) printf(" ponder %s", print_move(info->ponder_move));
+    printf("\n");
+    fflush(stdout);
 
   // for xboard protocol, we need to print the move (for the GUI to play)
   // as well as play it ourselves
   } else if(info->game_mode == XBOARDMODE) {
     printf("move %s\n", print_move(best_move));
+    fflush(stdout);
     make_move(board, best_move);
 
   // for console, we print the move very visibly and play it, then print
   // the board for the user to see
-  } else {
+  } else if(info->game_mode == CONSOLEMODE) {
     printf("\n\n***!! NotARook-ie makes move %s !!***\n\n", print_algebraic_move(best_move, board));
     make_move(board, best_move);
     print_board(board);
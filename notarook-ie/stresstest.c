@@ -4,12 +4,44 @@
  *
  * If you're gonna use your own .epd file, make sure it's formatted like the one
  * provided else this script won't work.
+ *
+ * By default it waits for you to press enter and then runs the positions one at a time
+ * (splitting each one between the threads). With --batch it starts right away and runs
+ * the positions themselves in parallel, one per thread, and --csv or --json print the
+ * results in a format scripts can read. Either way the exit code is nonzero if
+ * any of the tests failed, so it can be used as a check after movegen changes.
  */
 
 #include "constants.h"
 #include "functions.h"
 
-#define EXPECTED_ARG_COUNT 3
+#define MIN_ARG_COUNT 2
+#define MAX_ARG_COUNT 4
+#define DEFAULT_PERFT_HASH_MB 64
+#define MAX_FEN_LENGTH 128
+
+// how the results get printed
+enum OUTPUT_FORMATS { TEXT, CSV, JSON };
+
+// one line of the .epd file and how the test on it went
+typedef struct PerftCase {
+  char fen[MAX_FEN_LENGTH];
+  uint64_t expected;
+  uint64_t result;
+  unsigned long time; // ms
+} PerftCase_t;
+
+// shared by the threads in batch mode, positions are handed out one at a time
+typedef struct PerftBatch {
+  PerftCase_t *cases;
+  int32_t count;
+  int32_t next; // index of the next position nobody has taken yet
+  int32_t depth;
+  HashTable_t *ht;
+#ifndef WIN32
+  pthread_mutex_t lock; // guards next
+#endif
+} PerftBatch_t;
 
 static void die(const char * reason) {
   fprintf(stderr, "\n\t\033[91mERROR\033[0m: ");
@@ -32,82 +64,286 @@ static uint64_t grab_answer_value(char *rest, int32_t depth) {
   return 0;
 }
 
+/**
+ * Reads every test out of the .epd file. Returns the array of tests (which
+ * needs to be freed) and sets count to how many there are
+ */
+static PerftCase_t *load_cases(FILE *file, int32_t depth, int32_t *count) {
+  char instr[BUFSIZ], *token;
+  int32_t capacity = 128;
+  PerftCase_t *cases = malloc(capacity * sizeof(PerftCase_t));
+  if(!cases) die("Couldn't allocate memory for the tests.");
+
+  *count = 0;
+
+  // loop through the file line by line
+  while(fgets(instr, BUFSIZ, file)) {
+
+    token = strtok(instr, ";");
+    if(!token || !strchr(token, '/')) continue; // blank line
+
+    if(*count == capacity) {
+      capacity *= 2;
+      cases = realloc(cases, capacity * sizeof(PerftCase_t));
+      if(!cases) die("Couldn't allocate memory for the tests.");
+    }
+
+    PerftCase_t *test = &cases[(*count)++];
+    memset(test, 0, sizeof(PerftCase_t));
+    strncpy(test->fen, token, MAX_FEN_LENGTH - 1);
+
+    // get rid of the space between the fen and the answers
+    size_t length = strlen(test->fen);
+    while(length && isspace((unsigned char)test->fen[length - 1])) test->fen[--length] = '\0';
+
+    token = strtok(NULL, ";");
+
+    // grab the answer for what number we expect given the depth
+    test->expected = grab_answer_value(token, depth);
+
+    if(!test->expected) {
+      char die_str[BUFSIZ];
+      snprintf(die_str, BUFSIZ, "Depth %d is outside of the bounds of your perft test file.", depth);
+      die(die_str);
+    }
+  }
+
+  return cases;
+}
+
+/**
+ * Runs the perft test for a single position on a single thread
+ */
+static void run_case(PerftCase_t *test, int32_t depth, int32_t threads, HashTable_t *ht) {
+  Board_t board;
+  parse_FEN(test->fen, &board);
+
+  unsigned long start = get_time_millis();
+  test->result = perft_test(depth, &board, false, threads, ht);
+  test->time = get_time_millis() - start;
+}
+
+/**
+ * Keeps grabbing positions from the batch and testing them until there aren't any left
+ */
+static void *batch_worker(void *arg) {
+  PerftBatch_t *batch = (PerftBatch_t *)arg;
+
+  while(true) {
+#ifndef WIN32
+    pthread_mutex_lock(&batch->lock);
+#endif
+    int32_t idx = batch->next++;
+#ifndef WIN32
+    pthread_mutex_unlock(&batch->lock);
+#endif
+
+    if(idx >= batch->count) break;
+
+    run_case(&batch->cases[idx], batch->depth, 1, batch->ht);
+  }
+
+  return NULL;
+}
+
+/**
+ * Tests every position with one thread per position at a time
+ * (no pthreads on windows, see constants.h, so they all get tested one after another there)
+ */
+static void run_batch(PerftCase_t *cases, int32_t count, int32_t depth, int32_t threads, HashTable_t *ht) {
+
+#ifdef WIN32
+
+  PerftBatch_t batch = { cases, count, 0, depth, ht };
+  (void)threads;
+  batch_worker(&batch);
+
+#else
+
+  PerftBatch_t batch = { cases, count, 0, depth, ht, PTHREAD_MUTEX_INITIALIZER };
+  pthread_t handles[MAX_THREADS];
+
+  // the main thread pitches in too
+  int32_t started = 0;
+  for(int32_t idx = 1; idx < threads; ++idx) {
+    if(pthread_create(&handles[started], NULL, batch_worker, &batch)) break;
+    ++started;
+  }
+  batch_worker(&batch);
+  for(int32_t idx = 0; idx < started; ++idx) pthread_join(handles[idx], NULL);
+
+  pthread_mutex_destroy(&batch.lock);
+
+#endif
+}
+
+static uint64_t nodes_per_second(uint64_t nodes, unsigned long time) {
+  return nodes * 1000 / (time ? time : 1);
+}
+
+static void print_text_result(const PerftCase_t *test, int32_t number) {
+  printf("Test %d (FEN: %s): ", number, test->fen);
+  if(test->expected == test->result) {
+    printf("\033[92mPASSED\033[0m (expected: %llu got: %llu)\n", (unsigned long long)test->expected, (unsigned long long)test->result);
+  } else {
+    printf("\033[91mFAILED\033[0m (expected: %llu got: %llu)\n", (unsigned long long)test->expected, (unsigned long long)test->result);
+  }
+}
+
+static void print_csv(const PerftCase_t *cases, int32_t count, int32_t depth) {
+  printf("test,fen,depth,expected,nodes,time_ms,nps,passed\n");
+  for(int32_t idx = 0; idx < count; ++idx) {
+    const PerftCase_t *test = &cases[idx];
+    printf("%d,\"%s\",%d,%llu,%llu,%lu,%llu,%s\n", idx + 1, test->fen, depth,
+           (unsigned long long)test->expected, (unsigned long long)test->result, test->time,
+           (unsigned long long)nodes_per_second(test->result, test->time),
+           test->expected == test->result ? "true" : "false");
+  }
+}
+
+static void print_json(const PerftCase_t *cases, int32_t count, int32_t depth, int32_t threads,
+                       bool failed, uint64_t total_nodes, unsigned long elapsed) {
+  printf("{\n  \"depth\": %d,\n  \"threads\": %d,\n  \"passed\": %s,\n", depth, threads, failed ? "false" : "true");
+  printf("  \"nodes\": %llu,\n  \"time_ms\": %lu,\n  \"nps\": %llu,\n  \"tests\": [\n",
+         (unsigned long long)total_nodes, elapsed, (unsigned long long)nodes_per_second(total_nodes, elapsed));
+
+  for(int32_t idx = 0; idx < count; ++idx) {
+    const PerftCase_t *test = &cases[idx];
+    printf("    {\"test\": %d, \"fen\": \"%s\", \"expected\": %llu, \"nodes\": %llu, \"time_ms\": %lu, \"nps\": %llu, \"passed\": %s}%s\n",
+           idx + 1, test->fen, (unsigned long long)test->expected, (unsigned long long)test->result, test->time,
+           (unsigned long long)nodes_per_second(test->result, test->time),
+           test->expected == test->result ? "true" : "false", idx + 1 < count ? "," : "");
+  }
+
+  printf("  ]\n}\n");
+}
+
 int main(int argc, char *argv[]) {
 
-  if(argc != EXPECTED_ARG_COUNT) {
+  // pull the --options out, everything else is positional
+  bool batch = false;
+  int32_t format = TEXT;
+  char *args[MAX_ARG_COUNT];
+  int32_t arg_count = 0;
+
+  for(int32_t idx = 1; idx < argc; ++idx) {
+    if(!strcmp(argv[idx], "--batch")) {
+      batch = true;
+    } else if(!strcmp(argv[idx], "--csv")) {
+      batch = true;
+      format = CSV;
+    } else if(!strcmp(argv[idx], "--json")) {
+      batch = true;
+      format = JSON;
+    } else if(arg_count < MAX_ARG_COUNT && strncmp(argv[idx], "--", 2)) {
+      args[arg_count++] = argv[idx];
+    } else {
+      arg_count = MAX_ARG_COUNT + 1;
+      break;
+    }
+  }
+
+  if(arg_count < MIN_ARG_COUNT || arg_count > MAX_ARG_COUNT) {
     char die_str[BUFSIZ];
-    snprintf(die_str, BUFSIZ, "Expected two arguments.\n\n\tUSAGE: %s <depth int [1, 6]> <filename>.epd", argv[0]);
+    snprintf(die_str, BUFSIZ, "Expected two to four arguments.\n\n\tUSAGE: %s [--batch] [--csv | --json] <depth int [1, 6]> <filename>.epd [threads] [hash MB (0 for none)]", argv[0]);
     die(die_str);
   }
 
   init_all();
 
   // first up, parse the depth
-  int32_t depth = atoi(argv[1]);
+  int32_t depth = atoi(args[0]);
   if(!depth) {
     char die_str[BUFSIZ];
-    snprintf(die_str, BUFSIZ, "Depth \"%s\" isn't valid. Make sure your depth is within the bounds in your .epd file.", argv[1]);
+    snprintf(die_str, BUFSIZ, "Depth \"%s\" isn't valid. Make sure your depth is within the bounds in your .epd file.", args[0]);
     die(die_str);
   }
 
   // next up, parse the filename
-  char *filename = argv[2];
+  char *filename = args[1];
 
-  char instr[BUFSIZ], *token, fen[BUFSIZ];
-  memset(fen, '\0', BUFSIZ);
+  // then the (optional) number of threads, defaulting to one per cpu
+  // (perft only runs on one thread on windows anyways, see perft.c)
+#ifdef WIN32
+  int32_t threads = (arg_count > 2) ? atoi(args[2]) : 1;
+#else
+  int32_t threads = (arg_count > 2) ? atoi(args[2]) : (int32_t)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if(threads < 1) threads = 1;
+  if(threads > MAX_THREADS) threads = MAX_THREADS;
+
+  // and the (optional) size of the perft hash shared by the threads
+  int32_t hash_mb = (arg_count > 3) ? atoi(args[3]) : DEFAULT_PERFT_HASH_MB;
+  if(hash_mb > MAX_HASHSET_SIZE_MB) hash_mb = MAX_HASHSET_SIZE_MB;
+
+  HashTable_t perft_hash = { NULL, 0, 0 };
+  if(hash_mb > 0 && !init_hashset(&perft_hash, hash_mb)) die("Couldn't allocate the perft hash.");
+  HashTable_t *ht = perft_hash.table ? &perft_hash : NULL;
 
   FILE *file = fopen(filename, "r");
   if(!file) {
     char die_str[BUFSIZ];
-    snprintf(die_str, BUFSIZ, "Failed to open file \"%s\" (are you sure it exists/is spelt correctly?)", argv[2]);
+    snprintf(die_str, BUFSIZ, "Failed to open file \"%s\" (are you sure it exists/is spelt correctly?)", filename);
     die(die_str);
   }
 
-  printf("*************************STARTING PERFT TEST*************************\n");
-  printf("Chosen depth: %d\n", depth);
-  printf("\n\033[93mWARNING:\033[0m Depending on the depth chosen, this may take a while.\n");
-  printf("Press return/enter to continue...\n");
-  (void)getchar();
+  int32_t count;
+  PerftCase_t *cases = load_cases(file, depth, &count);
+  fclose(file);
 
-  int count = 1;
-  bool failed = false;
+  if(format == TEXT) {
+    printf("*************************STARTING PERFT TEST*************************\n");
+    printf("Chosen depth: %d\n", depth);
+    printf("Threads: %d Hash: %dMB\n", threads, hash_mb > 0 ? hash_mb : 0);
+  }
 
-  // loop through the file line by line
-  while(fgets(instr, BUFSIZ, file)) {
+  if(!batch) {
+    printf("\n\033[93mWARNING:\033[0m Depending on the depth chosen, this may take a while.\n");
+    printf("Press return/enter to continue...\n");
+    (void)getchar();
+  }
 
-    Board_t board;
-    token = strtok(instr, ";");
-    strncpy(fen, token, BUFSIZ);
+  // overall speed, handy for comparing builds (see `make perftbench`)
+  unsigned long start = get_time_millis();
 
-    parse_FEN(token, &board);
+  if(batch) {
+    run_batch(cases, count, depth, threads, ht);
+  } else {
+    // print as we go since this can take a while
+    for(int32_t idx = 0; idx < count; ++idx) {
+      run_case(&cases[idx], depth, threads, ht);
+      print_text_result(&cases[idx], idx + 1);
+    }
+  }
 
-    token = strtok(NULL, ";");
+  unsigned long elapsed = get_time_millis() - start;
 
-    // grab the answer for what number we expect given the depth
-    uint64_t expected = grab_answer_value(token, depth);
+  bool failed = false;
+  uint64_t total_nodes = 0;
+  for(int32_t idx = 0; idx < count; ++idx) {
+    total_nodes += cases[idx].result;
+    if(cases[idx].result != cases[idx].expected) failed = true;
+  }
 
-    if(!expected) {
-      char die_str[BUFSIZ];
-      snprintf(die_str, BUFSIZ, "Depth %d is outside of the bounds of your perft test file.", depth);
-      die(die_str);
+  if(format == CSV) {
+    print_csv(cases, count, depth);
+  } else if(format == JSON) {
+    print_json(cases, count, depth, threads, failed, total_nodes, elapsed);
+  } else {
+    if(batch) {
+      for(int32_t idx = 0; idx < count; ++idx) print_text_result(&cases[idx], idx + 1);
     }
 
-    uint64_t result = perft_test(depth, &board, true);
+    if(!failed) printf("\n                  ALL TESTS PASSED SUCCESSFULLY\n");
+    else printf("\nOne or more tests failed.\n");
 
-    printf("Test %d (FEN: %s): ", count++, fen);
-    if(expected == result) {
-      printf("\033[92mPASSED\033[0m (expected: %lld got: %lld)\n", expected, result);
-    } else {
-      printf("\033[91mFAILED\033[0m (expected: %lld got: %lld)\n", expected, result);
-      failed = true;
-    }
-  }
+    printf("Total nodes: %llu Time: %lu ms Nodes/sec: %llu\n", (unsigned long long)total_nodes, elapsed,
+           (unsigned long long)nodes_per_second(total_nodes, elapsed));
 
-  if(!failed) printf("\n                  ALL TESTS PASSED SUCCESSFULLY\n");
-  else printf("\nOne or more tests failed.\n");
-
-  printf("*************************ENDING PERFT TEST*************************\n");
+    printf("*************************ENDING PERFT TEST*************************\n");
+  }
 
-  fclose(file);
-  return EXIT_SUCCESS;
+  free(cases);
+  free(perft_hash.table);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -23,6 +23,10 @@ static void parse_go(char *line, SearchInfo_t *info, Board_t *board, bool using_
   char *ptr;
   info->timeset = false;
 
+  // search on the opponent's time until the GUI tells us they played
+  // the move we're pondering on ("ponderhit", see util.c) or to stop
+  ATOMIC_STORE(info->pondering, strstr(line, "ponder") != NULL);
+
   if((ptr = strstr(line, "infinite"))) {
     info->timeset = false; // we did this already but better than an empty if block IMO
   }
@@ -79,48 +83,90 @@ static void parse_go(char *line, SearchInfo_t *info, Board_t *board, bool using_
   search_position(board, info, using_book, book);
 }
 
+/**
+ * Plays the moves from a space separated list of moves (like the end of a position command).
+ * Returns false if one of them wasn't a valid move, in which case the rest are skipped
+ */
+static bool play_moves(char *moves, Board_t *board) {
+  uint32_t move;
+
+  while(*moves == ' ') moves++;
+  while(*moves) {
+    move = parse_move(moves, board);
+    if(move == NOMOVE) return false;
+
+    make_move(board, move);
+    board->ply = 0; // make_move changes the ply so reset it (these aren't legit moves)
+
+    // advance to the start of the next move
+    while(*moves && *moves != ' ') moves++;
+    while(*moves == ' ') moves++;
+  }
+
+  return true;
+}
+
 /**
  * Parses a given position in the line read from the GUI
  * This code _does_ assume that the format is consistently correct,
  * so if your GUI isn't correct you'll break this.
+ *
+ * last is the previous position command that's on the board. The GUI sends
+ * the whole game every single move, so when the new command is just the last one
+ * plus some moves, we only play the new moves instead of setting up the position
+ * and replaying the game from the start (this also keeps the board's history as is).
  */
-static void parse_position(char *line, Board_t *board) {
-  line += 9; // jump past "position "
-  char *tmp_ptr;
+static void parse_position(char *line, Board_t *board, char *last) {
+  char *tmp_ptr = NULL;
+  bool extends = false;
 
-  // we got a restart
-  if(!strncmp(line, "startpos", strlen("startpos"))) {
-    parse_FEN(START_FEN, board);
-  } else {
-    // look for the word fen and parse the section after that
-    // to get our starting position
-    tmp_ptr = strstr(line, "fen");
-    if(!tmp_ptr) parse_FEN(START_FEN, board); // failsafe
-    else {
-      // advance past the "fen " and parse what we see
-      tmp_ptr += 4;
-      parse_FEN(tmp_ptr, board);
+  // get rid of the newline (and any trailing spaces) so the commands compare cleanly
+  size_t len = strlen(line);
+  while(len && isspace((unsigned char)line[len - 1])) line[--len] = '\0';
+
+  size_t last_len = strlen(last);
+  if(last_len && !strncmp(line, last, last_len) && (line[last_len] == ' ' || !line[last_len])) {
+    tmp_ptr = line + last_len;
+    while(*tmp_ptr == ' ') tmp_ptr++;
+
+    // either more moves, or the last command didn't have any moves yet and this one does
+    // (anything else, like a longer FEN, is a different position)
+    if(strstr(last, "moves") || !*tmp_ptr) {
+      extends = true;
+    } else if(!strncmp(tmp_ptr, "moves", strlen("moves"))) {
+      tmp_ptr += strlen("moves");
+      extends = true;
     }
   }
 
-  tmp_ptr = strstr(line, "moves");
-  uint32_t move;
-  if(tmp_ptr) {
-    tmp_ptr += 6; // jump past "moves "
-    while(*tmp_ptr) {
-      move = parse_move(tmp_ptr, board);
-      // if we don't have a valid move break
-      // else, play the move
-      if(move == NOMOVE) break;
-
-      make_move(board, move);
-      board->ply = 0; // make_move changes the ply so reset it (these aren't legit moves)
-      // advance to the start of the next move
-      while(*tmp_ptr && *tmp_ptr != ' ') tmp_ptr++;
-      tmp_ptr++; // once we've hit a space, go to the next for the start of the command
+  if(!extends) {
+    line += 9; // jump past "position "
+
+    // we got a restart
+    if(!strncmp(line, "startpos", strlen("startpos"))) {
+      parse_FEN(START_FEN, board);
+    } else {
+      // look for the word fen and parse the section after that
+      // to get our starting position
+      tmp_ptr = strstr(line, "fen");
+      if(!tmp_ptr) parse_FEN(START_FEN, board); // failsafe
+      else {
+        // advance past the "fen " and parse what we see
+        tmp_ptr += 4;
+        parse_FEN(tmp_ptr, board);
+      }
     }
+
+    line -= 9;
+    tmp_ptr = strstr(line, "moves");
+    tmp_ptr = (tmp_ptr) ? tmp_ptr + strlen("moves") : line + len;
   }
 
+  // if a move didn't parse, the board doesn't match the command
+  // so the next one will have to start from scratch
+  if(play_moves(tmp_ptr, board)) strcpy(last, line);
+  else *last = '\0';
+
   print_board(board);
 }
 
@@ -131,7 +177,12 @@ static void print_init_info(void) {
   printf("id name %s\n", NAME);
   printf("id author npcompletenate\n");
   printf("option name Book type check default true\n");
+  // the GUI decides when we ponder (with "go ponder"), this just lets it know we can
+  printf("option name Ponder type check default false\n");
+  printf("option name Threads type spin default 1 min 1 max %d\n", MAX_THREADS);
+  printf("option name Hash type spin default %d min %d max %d\n", HASHSET_SIZE_MB, MIN_HASHSET_SIZE_MB, MAX_HASHSET_SIZE_MB);
   printf("uciok\n");
+  fflush(stdout);
 }
 
 /**
@@ -139,13 +190,11 @@ static void print_init_info(void) {
  */
 void UCI_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using_book) {
 
-  // first, turn off buffering for stdin and stdout
-  setvbuf(stdin, NULL, _IONBF, 0);
-  setvbuf(stdout, NULL, _IONBF, 0);
   info->game_mode = UCIMODE;
 
   // create the input buffer and let the GUI know we're ready to do battle
   char buf[UCI_BUFFER_SIZE];
+  char last_position[UCI_BUFFER_SIZE] = ""; // see parse_position()
   print_init_info();
 
   // main loop
@@ -154,22 +203,38 @@ void UCI_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using_bo
     memset(buf, '\0', UCI_BUFFER_SIZE);
     fflush(stdout);
 
-    if(!fgets(buf, UCI_BUFFER_SIZE, stdin)) continue;
+    get_input(buf, UCI_BUFFER_SIZE);
 
     if(*buf == '\n') continue;
 
     // case 1: the ready command
+    // ("stop" needs no handling here: the input thread takes care of it mid-search,
+    // and if we're not searching there's nothing to stop)
     if(!strncmp(buf, "isready", strlen("isready"))) {
       printf("readyok\n");
+      fflush(stdout);
       continue;
     } else if(!strncmp(buf, "position", strlen("position"))) {
-      parse_position(buf, board);
+      parse_position(buf, board, last_position);
     } else if(!strncmp(buf, "ucinewgame", strlen("ucinewgame"))) {
-      parse_position("position startpos\n", board);
+      clear_hashset(&board->hash_table);
+      strcpy(buf, "position startpos");
+      *last_position = '\0';
+      parse_position(buf, board, last_position);
     } else if(!strncmp(buf, "go", strlen("go"))) {
       parse_go(buf, info, board, using_book, book);
+    } else if(!strncmp(buf, "stats", strlen("stats"))) {
+      printf("info string ");
+      print_stats(board);
+    } else if(!strncmp(buf, "perft", strlen("perft"))) {
+      // not part of the protocol, but handy for checking the move generator from a GUI/script
+      int32_t depth = atoi(buf + 5);
+      if(depth > 0) print_perft(depth, board, false, info->threads);
+    } else if(!strncmp(buf, "divide", strlen("divide"))) {
+      int32_t depth = atoi(buf + 6);
+      if(depth > 0) print_perft(depth, board, true, info->threads);
     } else if(!strncmp(buf, "quit", strlen("quit"))) {
-      info->quit = true;
+      ATOMIC_STORE(info->quit, true);
       break;
     } else if(!strncmp(buf, "uci", strlen("uci"))) {
       print_init_info();
@@ -178,9 +243,21 @@ void UCI_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using_bo
       char *ptr = NULL;
       ptr = strstr(buf, "true");
       using_book = (ptr) ? true : false;
+    } else if(!strncmp(buf, "setoption name Threads value ", 29)) {
+      info->threads = atoi(buf + 29);
+      if(info->threads < 1) info->threads = 1;
+      if(info->threads > MAX_THREADS) info->threads = MAX_THREADS;
+      printf("info string searching with %d thread(s)\n", info->threads);
+    } else if(!strncmp(buf, "setoption name Hash value ", 26)) {
+      int32_t megabytes = atoi(buf + 26);
+      if(megabytes < MIN_HASHSET_SIZE_MB) megabytes = MIN_HASHSET_SIZE_MB;
+      if(megabytes > MAX_HASHSET_SIZE_MB) megabytes = MAX_HASHSET_SIZE_MB;
+      if(init_hashset(&board->hash_table, megabytes)) {
+        printf("info string hashset resized to %lu entries\n", board->hash_table.entries);
+      }
     }
 
     // check for quit if it was sent inside of when we said "go"
-    if(info->quit) break;
+    if(ATOMIC_LOAD(info->quit)) break;
   }
 }
@@ -28,25 +28,118 @@ unsigned long get_time_millis(void) {
 }
 
 /**
- * Peeks stdin to see if we need to interrupt our engine while it is thinking
+ * Input handling.
+ *
+ * stdin belongs to one thread that does nothing but read lines off of it.
+ * Lines go into a queue that the protocol loops pull from with get_input(),
+ * which means nobody has to poll stdin while searching: if something comes in
+ * mid-search that the search cares about ("stop", "quit", ...) the input thread
+ * sets the stop flag right then and there, however fast or slow we're searching.
+ *
+ * Windows doesn't get pthreads (see constants.h), so there's no input thread there.
+ * The loops read stdin themselves, and the search peeks at it every so often
+ * (see check_input()) and handles what it finds the same way the thread would.
  */
-static bool input_waiting(void) {
+
+// lines the input thread has read that the protocol loops haven't gotten to yet
+static char input_queue[INPUT_QUEUE_SIZE][UCI_BUFFER_SIZE];
+static int32_t queued = 0;
+static bool input_closed = false; // stdin hit EOF
 
 #ifndef WIN32
+// the input thread only gets to touch the queue/flags below with this held
+static pthread_mutex_t input_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t input_added = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t input_removed = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t search_input = PTHREAD_COND_INITIALIZER; // something came in mid-search
+#endif
 
-  fd_set readfds;
-  struct timeval tv;
-  FD_ZERO(&readfds);
-  FD_SET(fileno(stdin), &readfds);
+static SearchInfo_t *input_info = NULL; // the main thread's info, where "stop" goes
+static bool searching = false;
+static bool ready_pending = false; // "isready" came in mid-search
 
-  tv.tv_sec = 0;
-  tv.tv_usec = 0;
-  select(16, &readfds, 0, 0, &tv);
+/**
+ * Takes the input lock (nothing to lock on windows, there's only the one thread)
+ */
+static void lock_input(void) {
+#ifndef WIN32
+  pthread_mutex_lock(&input_lock);
+#endif
+}
 
-  return FD_ISSET(fileno(stdin), &readfds);
+static void unlock_input(void) {
+#ifndef WIN32
+  pthread_mutex_unlock(&input_lock);
+#endif
+}
 
-#else
+/**
+ * Deals with a line that came in while we're searching.
+ * Returns true if the protocol loop should still get the line afterwards
+ */
+static bool handle_search_input(const char *line) {
 
+  // quitting stops everything, but the loop still needs to see it to exit
+  if(!strncmp(line, "quit", strlen("quit"))) {
+    ATOMIC_STORE(input_info->quit, true);
+    ATOMIC_STORE(input_info->stopped, true);
+    return true;
+  }
+
+  // xboard and console mode have always treated any input as "stop thinking"
+  // (e.g. the "?" command for xboard), the loop then handles the command itself
+  if(input_info->game_mode != UCIMODE) {
+    ATOMIC_STORE(input_info->stopped, true);
+    return true;
+  }
+
+  if(!strncmp(line, "stop", strlen("stop"))) {
+    ATOMIC_STORE(input_info->stopped, true);
+    return false;
+  }
+
+  // the opponent played the move we were pondering on, so the search is
+  // for real now and our clock starts running (the time we were given
+  // with "go ponder" counts from here)
+  if(!strncmp(line, "ponderhit", strlen("ponderhit"))) {
+    if(ATOMIC_LOAD(input_info->pondering)) {
+      unsigned long now = get_time_millis();
+      input_info->stoptime = now + (input_info->stoptime - input_info->starttime);
+      input_info->starttime = now;
+      // the release store is what makes the new clock visible to check_up()
+      // before it stops treating the search as a ponder search
+      ATOMIC_STORE(input_info->pondering, false);
+    }
+    return false;
+  }
+
+  // UCI says we have to answer this even while searching. The search thread
+  // prints it (see check_input()) so it doesn't land in the middle of an info line
+  if(!strncmp(line, "isready", strlen("isready"))) {
+    ATOMIC_STORE(ready_pending, true);
+    return false;
+  }
+
+  // anything else (like the next "position") waits for the search to finish
+  return true;
+}
+
+/**
+ * Copies the oldest queued line into buf and takes it off of the queue
+ */
+static void pop_input(char *buf, const int32_t size) {
+  strncpy(buf, input_queue[0], size - 1);
+  buf[size - 1] = '\0';
+  --queued;
+  memmove(input_queue[0], input_queue[1], queued * sizeof(input_queue[0]));
+}
+
+#ifdef WIN32
+
+/**
+ * Peeks stdin to see if there's anything to read without blocking
+ */
+static bool input_waiting(void) {
   static int init = 0, pipe;
   static HANDLE inh;
   DWORD dw;
@@ -67,31 +160,202 @@ static bool input_waiting(void) {
     GetNumberOfConsoleInputEvents(inh, &dw);
     return dw <= 1 ? 0 : dw;
   }
+}
+
+/**
+ * No input thread on windows, the loops read stdin themselves. It has to be
+ * unbuffered though, or lines could sit in stdio's buffer where peeking
+ * at stdin mid-search can't see them
+ */
+void start_input_thread(SearchInfo_t *info) {
+  input_info = info;
+  setvbuf(stdin, NULL, _IONBF, 0);
+}
+
+/**
+ * Gets the next line of input into buf (newline included, like fgets): whatever
+ * got read in mid-search first, then straight from stdin. Once stdin is closed,
+ * every line is "quit"
+ */
+void get_input(char *buf, const int32_t size) {
+  if(queued) {
+    pop_input(buf, size);
+    return;
+  }
+
+  if(input_closed || !fgets(buf, size, stdin)) {
+    input_closed = true;
+    strncpy(buf, "quit\n", size - 1);
+    buf[size - 1] = '\0';
+  }
+}
+
+#else
+
+/**
+ * The input thread: read lines forever and hand them off
+ */
+static void *input_loop(void *arg) {
+  (void)arg;
+  char line[UCI_BUFFER_SIZE];
+
+  while(fgets(line, UCI_BUFFER_SIZE, stdin)) {
+    pthread_mutex_lock(&input_lock);
+
+    bool keep = true;
+    if(searching) {
+      keep = handle_search_input(line);
+      pthread_cond_signal(&search_input);
+    }
+
+    if(keep) {
+      // the loops are way behind, wait for them to catch up
+      while(queued == INPUT_QUEUE_SIZE) pthread_cond_wait(&input_removed, &input_lock);
+      strcpy(input_queue[queued++], line);
+      pthread_cond_signal(&input_added);
+    }
+
+    pthread_mutex_unlock(&input_lock);
+  }
+
+  // stdin closed, so whoever reads next gets told to quit (see get_input())
+  pthread_mutex_lock(&input_lock);
+  input_closed = true;
+  if(searching) handle_search_input("quit");
+  pthread_cond_signal(&input_added);
+  pthread_cond_signal(&search_input);
+  pthread_mutex_unlock(&input_lock);
+
+  return NULL;
+}
+
+/**
+ * Starts up the input thread. From here on out, read stdin with get_input()
+ */
+void start_input_thread(SearchInfo_t *info) {
+  pthread_t handle;
+  input_info = info;
+  if(pthread_create(&handle, NULL, input_loop, NULL)) {
+    fprintf(stderr, "Couldn't start the input thread.\n");
+    exit(1);
+  }
+  pthread_detach(handle);
+}
+
+/**
+ * Waits for the next line of input and copies it into buf (newline included,
+ * like fgets). Once stdin is closed, every line is "quit"
+ */
+void get_input(char *buf, const int32_t size) {
+  pthread_mutex_lock(&input_lock);
+
+  while(!queued && !input_closed) pthread_cond_wait(&input_added, &input_lock);
+
+  if(queued) {
+    pop_input(buf, size);
+    pthread_cond_signal(&input_removed);
+  } else {
+    strncpy(buf, "quit\n", size - 1);
+    buf[size - 1] = '\0';
+  }
+
+  pthread_mutex_unlock(&input_lock);
+}
 
 #endif
+
+/**
+ * Lets the input thread know a search is starting. Anything queued up that
+ * was meant to stop it (e.g. "go" and "stop" sent right after each other)
+ * gets dealt with now, since the loop won't read it until the search is over
+ */
+void input_search_started(void) {
+  lock_input();
+
+  searching = true;
+  int32_t kept = 0;
+  for(int32_t idx = 0; idx < queued; ++idx) {
+    if(!handle_search_input(input_queue[idx])) continue;
+    if(kept != idx) memcpy(input_queue[kept], input_queue[idx], UCI_BUFFER_SIZE);
+    ++kept;
+  }
+#ifndef WIN32
+  if(kept != queued) pthread_cond_signal(&input_removed);
+#endif
+  queued = kept;
+
+  unlock_input();
+}
+
+/**
+ * Lets the input thread know the search is over (call it before printing the
+ * best move: whatever the GUI sends after that is for the loop)
+ */
+void input_search_stopped(void) {
+  lock_input();
+  searching = false;
+  unlock_input();
+
+  check_input();
 }
 
 /**
- * Reads in standard input values if there is indeed
- * input to be read
+ * Used when a ponder search has nothing left to search: waits until
+ * the opponent moves (ponderhit) or we're told to stop
  */
-void read_input(SearchInfo_t *info) {
-  int32_t bytes;
-  char input[256] = "", *endc = NULL;
+void wait_for_ponder_end(SearchInfo_t *info) {
 
-  if(input_waiting()) {
-    info->stopped = true;
-    do {
-      bytes = read(fileno(stdin), input, sizeof(input));
-    } while(bytes < 0);
-    endc = strchr(input, '\n');
-    if(endc) *endc = '\0';
+#ifdef WIN32
+
+  // nobody to wake us up, so keep checking stdin ourselves
+  while(ATOMIC_LOAD(info->pondering) && !ATOMIC_LOAD(info->stopped)) {
+    check_input();
+    Sleep(10);
+  }
 
-    // handle the command sent in
-    if(strlen(input) > 0) {
-      if(!strncmp(input, "quit", strlen("quit"))) {
-        info->quit = true;
-      }
+#else
+
+  pthread_mutex_lock(&input_lock);
+  while(ATOMIC_LOAD(info->pondering) && !ATOMIC_LOAD(info->stopped)) {
+    pthread_cond_wait(&search_input, &input_lock);
+
+    // the search isn't around to answer "isready" anymore, so do it here
+    if(ATOMIC_LOAD(ready_pending)) {
+      pthread_mutex_unlock(&input_lock);
+      check_input();
+      pthread_mutex_lock(&input_lock);
     }
   }
+  pthread_mutex_unlock(&input_lock);
+
+#endif
+}
+
+/**
+ * Called by the search every so often to take care of what the input thread
+ * left for it. Only costs a flag check when there's nothing to do
+ * (on windows it reads whatever is waiting on stdin first, since there's no input thread)
+ */
+void check_input(void) {
+
+#ifdef WIN32
+  char line[UCI_BUFFER_SIZE];
+  while(searching && !input_closed && queued < INPUT_QUEUE_SIZE && input_waiting()) {
+    if(!fgets(line, UCI_BUFFER_SIZE, stdin)) {
+      input_closed = true;
+      handle_search_input("quit");
+      break;
+    }
+    if(handle_search_input(line)) strcpy(input_queue[queued++], line);
+  }
+#endif
+
+  if(!ATOMIC_LOAD(ready_pending)) return;
+
+  lock_input();
+  ATOMIC_STORE(ready_pending, false);
+  unlock_input();
+
+  printf("readyok\n");
+  fflush(stdout);
 }
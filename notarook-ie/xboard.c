@@ -107,10 +107,30 @@ bool check_result(Board_t *board) {
  * Used when given the "protover 2" command
  */
 static void print_options(void) {
-  printf("feature ping=1 setboard=1 nps=0 san=0 myname=\"NotARook-ie\" colors=0 usermove=1 sigint=0 sigterm=0 post=1 nopost=1\n");
+  printf("feature ping=1 setboard=1 nps=0 san=0 myname=\"NotARook-ie\" colors=0 usermove=1 sigint=0 sigterm=0 post=1 nopost=1 smp=1 memory=1\n");
   printf("feature done=1\n");
 }
 
+/**
+ * Thinks on the opponent's time (turned on with "hard").
+ * Plays the reply we expect from our last search's PV and searches from there
+ * until the opponent actually moves. Xboard doesn't tell us when we guessed right
+ * the way UCI does, so the search is thrown away either way, but everything it put
+ * into the hashset is still there for the real search to pick up
+ */
+static void ponder_search(Board_t *board, SearchInfo_t *info, Polybook_t book) {
+  uint32_t guess = info->ponder_move;
+  if(guess == NOMOVE || !make_move(board, guess)) return;
+
+  info->starttime = get_time_millis();
+  info->timeset = false;
+  info->depth = MAX_DEPTH;
+  ATOMIC_STORE(info->pondering, true);
+  search_position(board, info, false, book);
+
+  take_move(board);
+}
+
 /**
  * Main loop for interacting with GUIs via the XBoard/Winboard protocol
  * Implementation is inspired by the forum post where the inventor of the protocol
@@ -118,10 +138,6 @@ static void print_options(void) {
  */
 void XBoard_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using_book) {
 
-  // first, turn off buffering for stdin and stdout
-  setvbuf(stdin, NULL, _IONBF, 0);
-  setvbuf(stdout, NULL, _IONBF, 0);
-
   info->game_mode = XBOARDMODE;
   info->post_thinking = true;
   info->initial_time = -1;
@@ -133,6 +149,7 @@ void XBoard_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using
   int32_t sec;
   int32_t mps; // moves per session
   uint32_t move = NOMOVE;
+  bool ponder = false;
 
   // set up input and command buffers
   char in[XBOARD_BUFFER_SIZE], cmd[XBOARD_BUFFER_SIZE];
@@ -168,6 +185,9 @@ void XBoard_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using
           movestogo[board->side ^ 1] = mps;
         }
       }
+
+      // keep thinking while the opponent does, until they send their move (or anything else)
+      if(ponder) ponder_search(board, info, book);
     }
 
     fflush(stdout);
@@ -177,7 +197,7 @@ void XBoard_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using
     fflush(stdout);
 
     // grab the input command
-    if(!fgets(in, XBOARD_BUFFER_SIZE, stdin)) continue;
+    get_input(in, XBOARD_BUFFER_SIZE);
 
     // replace the newline with a null
     in[strcspn(in, "\n")] = '\0';
@@ -187,7 +207,7 @@ void XBoard_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using
 
     // end the loop (and the program)
     if(!strcmp(cmd, "quit")) {
-      info->quit = true;
+      ATOMIC_STORE(info->quit, true);
       break;
     }
 
@@ -212,6 +232,27 @@ void XBoard_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using
       continue;
     }
 
+    // set how many threads to search with
+    if(!strcmp(cmd, "cores")) {
+      sscanf(in, "cores %d", &info->threads);
+      if(info->threads < 1) info->threads = 1;
+      if(info->threads > MAX_THREADS) info->threads = MAX_THREADS;
+      printf("ok, searching with %d thread(s)\n", info->threads);
+      continue;
+    }
+
+    // set how much memory (in MB) the hashset gets
+    if(!strcmp(cmd, "memory")) {
+      int32_t megabytes = HASHSET_SIZE_MB;
+      sscanf(in, "memory %d", &megabytes);
+      if(megabytes < MIN_HASHSET_SIZE_MB) megabytes = MIN_HASHSET_SIZE_MB;
+      if(megabytes > MAX_HASHSET_SIZE_MB) megabytes = MAX_HASHSET_SIZE_MB;
+      if(init_hashset(&board->hash_table, megabytes)) {
+        printf("ok, hashset resized to %lu entries\n", board->hash_table.entries);
+      }
+      continue;
+    }
+
     // set the max move time for one move
     if(!strcmp(cmd, "st")) {
       sscanf(in, "st %d", &movetime);
@@ -250,13 +291,23 @@ void XBoard_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using
     // print out the value we are "ping"-ed
     if(!strcmp(cmd, "ping")) {
       printf("pong%s\n", in + 4);
+      fflush(stdout);
+      continue;
+    }
+
+    // print how well the evaluation caches are doing
+    // (not part of the protocol, xboard will just ignore it)
+    if(!strcmp(cmd, "stats")) {
+      printf("# ");
+      print_stats(board);
       continue;
     }
 
     // new game
-    // set engine to black, reset the depth, reset the board
+    // set engine to black, reset the depth, reset the board and the hashset
     if(!strcmp(cmd, "new")) {
       engine_side = BLACK;
+      clear_hashset(&board->hash_table);
       parse_FEN(START_FEN, board);
       depth = -1;
       printf("ok, resetting depth and starting a new game\n");
@@ -277,6 +328,20 @@ void XBoard_loop(Board_t *board, SearchInfo_t *info, Polybook_t book, bool using
       continue;
     }
 
+    // think on the opponent's time
+    if(!strcmp(cmd, "hard")) {
+      ponder = true;
+      printf("ok, engine will ponder.\n");
+      continue;
+    }
+
+    // don't think on the opponent's time
+    if(!strcmp(cmd, "easy")) {
+      ponder = false;
+      printf("ok, engine won't ponder.\n");
+      continue;
+    }
+
     // engine posts thought process
     if(!strcmp(cmd, "post")) {
       info->post_thinking = true;